@@ -0,0 +1,167 @@
+#include "AudioFileLoader.h"
+#include <juce_dsp/juce_dsp.h>
+#include <numeric>
+
+
+PolyphaseResampler::PolyphaseResampler(int sourceSampleRate, int targetSampleRate)
+{
+    jassert(sourceSampleRate > 0 && targetSampleRate > 0);
+
+    const int divisor = std::gcd(sourceSampleRate, targetSampleRate);
+    upFactor = targetSampleRate / divisor;
+    downFactor = sourceSampleRate / divisor;
+
+    if (upFactor == downFactor)
+        return;
+
+    //The filter must span more input samples when the cutoff is lower than the input Nyquist
+    const double ratio = juce::jmax(1.0, (double) downFactor / upFactor);
+    const int halfTaps = (int) std::ceil(baseTapsPerPhase * ratio / 2);
+    numTaps = 2 * halfTaps + 1;
+
+    //Prototype lowpass at the upsampled rate, centred on tap halfTaps * L
+    const int prototypeLength = (numTaps - 1) * upFactor + 1;
+    const double centre = halfTaps * (double) upFactor;
+    const double cutoff = rolloff * 0.5 / juce::jmax(upFactor, downFactor); //cycles per upsampled sample
+
+    std::vector<float> window((size_t) prototypeLength);
+    juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), window.size(),
+                                                             juce::dsp::WindowingFunction<float>::kaiser, false, kaiserBeta);
+
+    //Gain L makes up for the zeros inserted by the upsampling
+    std::vector<double> prototype((size_t) prototypeLength);
+    for (int j = 0; j < prototypeLength; ++j)
+    {
+        const double x = j - centre;
+        const double sinc = x == 0.0 ? 1.0 : std::sin(juce::MathConstants<double>::twoPi * cutoff * x) / (juce::MathConstants<double>::twoPi * cutoff * x);
+        prototype[(size_t) j] = upFactor * 2.0 * cutoff * sinc * window[(size_t) j];
+    }
+
+    //Output n sits at upsampled position n * M = base * L + phase, and reads the inputs
+    //base - halfTaps ... base + halfTaps: input base - halfTaps + i is weighted by tap phase + (numTaps - 1 - i) * L
+    coefficients.assign((size_t) (upFactor * numTaps), 0.0f);
+    for (int phase = 0; phase < upFactor; ++phase)
+    {
+        for (int i = 0; i < numTaps; ++i)
+        {
+            const int j = phase + (numTaps - 1 - i) * upFactor;
+            if (j < prototypeLength)
+                coefficients[(size_t) (phase * numTaps + i)] = (float) prototype[(size_t) j];
+        }
+    }
+
+    //The zeros before the stream
+    history.assign((size_t) halfTaps, 0.0f);
+    historyStart = -halfTaps;
+}
+
+juce::int64 PolyphaseResampler::getNumOutputSamples(juce::int64 numInputSamples) const noexcept
+{
+    //Outputs at positions n * M / L < numInputSamples
+    return (numInputSamples * upFactor + downFactor - 1) / downFactor;
+}
+
+int PolyphaseResampler::process(const float* input, int numInput, float* output, int maxOutput)
+{
+    if (upFactor == downFactor)
+    {
+        const int numOutput = juce::jmin(numInput, maxOutput);
+        std::copy(input, input + numOutput, output);
+        return numOutput;
+    }
+
+    history.insert(history.end(), input, input + numInput);
+
+    const int halfTaps = numTaps / 2;
+    const juce::int64 historyEnd = historyStart + (juce::int64) history.size();
+
+    int numOutput = 0;
+    while (numOutput < maxOutput)
+    {
+        const juce::int64 position = nextOutput * downFactor;
+        const juce::int64 base = position / upFactor;
+
+        //The last input this output needs has not arrived yet
+        if (base + halfTaps >= historyEnd)
+            break;
+
+        const float* x = history.data() + (base - halfTaps - historyStart);
+        const float* h = coefficients.data() + (position % upFactor) * numTaps;
+
+        //Four partial sums, so the compiler can vectorise the dot product
+        float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+        int i = 0;
+        for (; i + 4 <= numTaps; i += 4)
+        {
+            sum0 += x[i] * h[i];
+            sum1 += x[i + 1] * h[i + 1];
+            sum2 += x[i + 2] * h[i + 2];
+            sum3 += x[i + 3] * h[i + 3];
+        }
+        for (; i < numTaps; ++i)
+            sum0 += x[i] * h[i];
+
+        output[numOutput++] = (sum0 + sum1) + (sum2 + sum3);
+        ++nextOutput;
+    }
+
+    //Drop the inputs the next outputs will not use
+    const juce::int64 firstNeeded = (nextOutput * downFactor) / upFactor - halfTaps;
+    const juce::int64 numToDrop = juce::jlimit((juce::int64) 0, (juce::int64) history.size(), firstNeeded - historyStart);
+    history.erase(history.begin(), history.begin() + (std::ptrdiff_t) numToDrop);
+    historyStart += numToDrop;
+
+    return numOutput;
+}
+
+int PolyphaseResampler::finish(float* output, int maxOutput)
+{
+    if (upFactor == downFactor)
+        return 0;
+
+    const std::vector<float> zeros((size_t) numTaps, 0.0f);
+    return process(zeros.data(), numTaps, output, maxOutput);
+}
+
+
+AudioFileLoader::AudioFileLoader(juce::AudioFormatReader& reader, double targetSampleRate)
+    : reader(reader), resampler(juce::roundToInt(reader.sampleRate), juce::roundToInt(targetSampleRate))
+{
+    numOutputSamples = (int) resampler.getNumOutputSamples(reader.lengthInSamples);
+
+    chunk.setSize((int) reader.numChannels, chunkSize);
+    mono.resize((size_t) chunkSize);
+}
+
+bool AudioFileLoader::read(float* destination, const std::function<bool(float)>& progress)
+{
+    const juce::int64 length = reader.lengthInSamples;
+    const int numChannels = chunk.getNumChannels();
+
+    int written = 0;
+
+    for (juce::int64 start = 0; start < length; start += chunkSize)
+    {
+        const int numSamples = (int) juce::jmin((juce::int64) chunkSize, length - start);
+
+        reader.read(&chunk, 0, numSamples, start, true, true);
+
+        //Mix down to mono
+        juce::FloatVectorOperations::copy(mono.data(), chunk.getReadPointer(0), numSamples);
+        for (int channel = 1; channel < numChannels; ++channel)
+            juce::FloatVectorOperations::add(mono.data(), chunk.getReadPointer(channel), numSamples);
+
+        if (numChannels > 1)
+            juce::FloatVectorOperations::multiply(mono.data(), 1.0f / (float) numChannels, numSamples);
+
+        written += resampler.process(mono.data(), numSamples, destination + written, numOutputSamples - written);
+
+        if (!progress((float) (start + numSamples) / (float) length))
+            return false;
+    }
+
+    written += resampler.finish(destination + written, numOutputSamples - written);
+
+    jassert(written == numOutputSamples);
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <functional>
+#include <vector>
+
+
+//Rational sample rate converter (upsample by L, lowpass, downsample by M),
+//computed as a polyphase FIR: every output sample only uses the L-th of the
+//windowed-sinc taps that falls on input samples.
+//Input is pushed in chunks of any size, the outputs that can be computed are written straight away.
+class PolyphaseResampler
+{
+public:
+
+    PolyphaseResampler(int sourceSampleRate, int targetSampleRate);
+
+    //Number of output samples for a stream of numInputSamples
+    juce::int64 getNumOutputSamples(juce::int64 numInputSamples) const noexcept;
+
+    //Push numInput samples and write the output samples that are ready (at most maxOutput).
+    //Returns the number of samples written
+    int process(const float* input, int numInput, float* output, int maxOutput);
+
+    //End of the stream: write the remaining output samples (the input is padded with zeros)
+    int finish(float* output, int maxOutput);
+
+
+private:
+
+    //Taps per phase for an output rate as high as the input rate (longer when downsampling)
+    static constexpr int baseTapsPerPhase = 64;
+
+    //Passband edge as a fraction of the lower Nyquist frequency
+    static constexpr double rolloff = 0.9;
+
+    static constexpr float kaiserBeta = 8.0f;
+
+    int upFactor = 1; //L
+    int downFactor = 1; //M
+    int numTaps = 1; //per phase, odd: the centre tap falls on an input sample
+
+    //numTaps coefficients for each of the L phases, in input order
+    std::vector<float> coefficients;
+
+    //Input samples from index historyStart (negative indices are the zeros before the stream)
+    std::vector<float> history;
+    juce::int64 historyStart = 0;
+
+    juce::int64 nextOutput = 0;
+
+};
+
+
+//Streaming reader for the reference audio: decodes the file in chunks, mixes them
+//down to mono and resamples them to the rate of the network, writing into the caller's memory
+//(the storage of the input tensor). No full-rate copy of the file is kept.
+class AudioFileLoader
+{
+public:
+
+    //The reader must stay valid while the loader is used
+    AudioFileLoader(juce::AudioFormatReader& reader, double targetSampleRate);
+
+    //Length of the decoded audio at the target rate
+    int getNumOutputSamples() const noexcept { return numOutputSamples; }
+
+    //Decode the whole file into destination (getNumOutputSamples() long).
+    //progress is called after each chunk with the fraction read: the loading stops
+    //and returns false when it returns false
+    bool read(float* destination, const std::function<bool(float)>& progress);
+
+
+private:
+
+    static constexpr int chunkSize = 16384;
+
+    juce::AudioFormatReader& reader;
+    PolyphaseResampler resampler;
+    int numOutputSamples = 0;
+
+    juce::AudioBuffer<float> chunk;
+    std::vector<float> mono;
+
+};
@@ -0,0 +1,194 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <memory>
+
+
+//Thread building in the background what the audio thread asks for (wavetables, reverb responses, frozen notes).
+//The audio thread never waits nor notifies (notify() could block): it raises a flag, which the builder polls.
+//Derived classes implement build(), start the thread at the end of their constructor and stop it at the start
+//of their destructor (build() uses their members).
+class BackgroundBuilder : protected juce::Thread
+{
+public:
+
+    explicit BackgroundBuilder(const juce::String& threadName) : juce::Thread(threadName) {}
+
+    //Audio thread: a new build is needed (its data is written before)
+    void requestBuild() noexcept
+    {
+        ++requestNumber;
+        requestPending.store(true);
+    }
+
+    //Offline rendering: wait until the builder is done with the last request. False if it took longer than timeoutMs
+    bool waitForBuild(int timeoutMs) const
+    {
+        const auto end = juce::Time::getMillisecondCounter() + (juce::uint32) timeoutMs;
+
+        while (builtNumber.load() != requestNumber.load())
+        {
+            if (juce::Time::getMillisecondCounter() > end)
+                return false;
+
+            juce::Thread::sleep(1);
+        }
+
+        return true;
+    }
+
+
+protected:
+
+    static constexpr int pollMilliseconds = 10;
+
+    //Builder thread: one request (the requests arriving meanwhile are handled by the next call)
+    virtual void build() = 0;
+
+    //A request arrived since build() was called: a long build can give up
+    bool isRequestPending() const noexcept { return requestPending.load(); }
+
+
+private:
+
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            if (requestPending.exchange(false))
+            {
+                const int number = requestNumber.load();
+                build();
+                builtNumber.store(number);
+            }
+
+            wait(pollMilliseconds);
+        }
+    }
+
+    std::atomic<bool> requestPending{ false };
+    std::atomic<int> requestNumber{ 0 }; //of the last request, and of the last one built
+    std::atomic<int> builtNumber{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(BackgroundBuilder)
+};
+
+
+//Hands the slots a BackgroundBuilder fills to the audio thread without locks nor copies.
+//The builder fills a slot which is neither published nor held by the audio thread, then publishes it.
+//The audio thread holds up to two slots: the active one, and the previous one while it crossfades from it
+//(numSlots = 4: one published, two held, one for the builder). With 3 slots and a crossfade the builder waits
+//for hasFreeSlot() while a published slot is not swapped in yet and two are held.
+//A slot is only taken once marked as held and checked to be still published, so the builder never writes it.
+//Slot needs a sampleRate member: the slots built for the rate before reset() are skipped.
+template <typename Slot, int numSlots>
+class SlotHandover
+{
+public:
+
+    static_assert(numSlots >= 3, "one published slot, one held and one for the builder at least");
+
+    SlotHandover()
+    {
+        for (auto& slot : slots)
+            slot = std::make_unique<Slot>();
+    }
+
+    //prepareToPlay: drop the slots built so far, the next ones are built at this rate
+    void reset(double newSampleRate) noexcept
+    {
+        sampleRate.store(newSampleRate);
+        publishedSlot.store(-1);
+        activeSlot.store(-1);
+        fadingSlot.store(-1);
+    }
+
+    double getSampleRate() const noexcept { return sampleRate.load(); }
+
+    //Builder thread: whether getFreeSlot() has one (the audio thread only ever takes the published slot)
+    bool hasFreeSlot() const noexcept { return findFreeSlot() < numSlots; }
+
+    //Builder thread: a slot to fill, then publish it
+    Slot& getFreeSlot() noexcept
+    {
+        builderSlot = findFreeSlot();
+        jassert(builderSlot < numSlots);
+
+        return *slots[(size_t) builderSlot];
+    }
+
+    void publish() noexcept { publishedSlot.store(builderSlot); }
+
+    //Audio thread: make the last published slot the active one, if it is new (and built at the current rate).
+    //keepPrevious holds the active slot until releasePrevious(), e.g. for a crossfade. True if a slot was swapped in
+    bool swapIn(bool keepPrevious) noexcept
+    {
+        const int active = activeSlot.load();
+        int slot = publishedSlot.load();
+
+        if (slot < 0 || slot == active)
+            return false;
+
+        fadingSlot.store(keepPrevious ? active : -1);
+
+        for (;;)
+        {
+            activeSlot.store(slot);
+
+            const int current = publishedSlot.load();
+            if (current == slot)
+                break;
+
+            slot = current;
+        }
+
+        //A slot built for the rate before reset() is skipped, the right one follows.
+        //The previous slot is only still safe to use if it was held
+        if (slots[(size_t) slot]->sampleRate != sampleRate.load())
+        {
+            activeSlot.store(keepPrevious ? active : -1);
+            fadingSlot.store(-1);
+            return false;
+        }
+
+        return true;
+    }
+
+    //Audio thread: nullptr if none
+    const Slot* getActive() const noexcept { return get(activeSlot.load()); }
+    const Slot* getPrevious() const noexcept { return get(fadingSlot.load()); }
+
+    void releasePrevious() noexcept { fadingSlot.store(-1); }
+    void releaseActive() noexcept { activeSlot.store(-1); }
+
+
+private:
+
+    const Slot* get(int slot) const noexcept { return slot >= 0 ? slots[(size_t) slot].get() : nullptr; }
+
+    int findFreeSlot() const noexcept
+    {
+        const int published = publishedSlot.load();
+        const int active = activeSlot.load();
+        const int fading = fadingSlot.load();
+
+        int slot = 0;
+        while (slot < numSlots && (slot == published || slot == active || slot == fading))
+            ++slot;
+
+        return slot;
+    }
+
+    std::array<std::unique_ptr<Slot>, numSlots> slots;
+
+    std::atomic<int> publishedSlot{ -1 };
+    std::atomic<int> activeSlot{ -1 }; //written by the audio thread, the builder never writes these two
+    std::atomic<int> fadingSlot{ -1 };
+
+    int builderSlot = 0; //only used by the builder
+
+    std::atomic<double> sampleRate{ 44100.0 };
+
+    JUCE_DECLARE_NON_COPYABLE(SlotHandover)
+};
@@ -0,0 +1,148 @@
+#include "BlockEnvelope.h"
+
+
+void BlockEnvelope::setSampleRate(double newSampleRate)
+{
+    jassert(newSampleRate > 0.0);
+    sampleRate = newSampleRate;
+    recalculateRates();
+}
+
+void BlockEnvelope::setParameters(const juce::ADSR::Parameters& newParameters)
+{
+    parameters = newParameters;
+    recalculateRates();
+}
+
+void BlockEnvelope::noteOn() noexcept
+{
+    if (attackRate > 0.0f)
+    {
+        state = State::attack;
+    }
+    else if (decayRate > 0.0f)
+    {
+        envelopeVal = 1.0f;
+        state = State::decay;
+    }
+    else
+    {
+        envelopeVal = parameters.sustain;
+        state = State::sustain;
+    }
+}
+
+void BlockEnvelope::noteOff() noexcept
+{
+    if (state == State::idle)
+        return;
+
+    if (parameters.release > 0.0f)
+    {
+        //The release always takes the same time, whatever level it starts from
+        releaseRate = static_cast<float>(envelopeVal / (parameters.release * sampleRate));
+        state = State::release;
+    }
+    else
+    {
+        reset();
+    }
+}
+
+void BlockEnvelope::reset() noexcept
+{
+    envelopeVal = 0.0f;
+    state = State::idle;
+}
+
+void BlockEnvelope::renderNextBlock(float* destination, int numSamples) noexcept
+{
+    while (numSamples > 0)
+    {
+        int written = numSamples;
+
+        switch (state)
+        {
+            case State::idle:
+                juce::FloatVectorOperations::clear(destination, numSamples);
+                break;
+
+            case State::sustain:
+                envelopeVal = parameters.sustain;
+                juce::FloatVectorOperations::fill(destination, envelopeVal, numSamples);
+                break;
+
+            case State::attack:
+                written = renderSegment(destination, numSamples, attackRate, 1.0f);
+                break;
+
+            case State::decay:
+                written = renderSegment(destination, numSamples, -decayRate, parameters.sustain);
+                break;
+
+            case State::release:
+                written = renderSegment(destination, numSamples, -releaseRate, 0.0f);
+                break;
+        }
+
+        destination += written;
+        numSamples -= written;
+    }
+}
+
+int BlockEnvelope::renderSegment(float* destination, int numSamples, float rate, float limit) noexcept
+{
+    //Samples needed to reach the end of the segment (the last one lands exactly on the limit)
+    //(a release starting from zero has no rate, and ends straight away like in juce::ADSR)
+    const float distance = rate != 0.0f ? (limit - envelopeVal) / rate : 0.0f;
+    const int segmentLength = distance > static_cast<float>(numSamples) ? numSamples + 1
+                                                                          : juce::jmax(1, static_cast<int>(std::ceil(distance)));
+
+    const int length = juce::jmin(segmentLength, numSamples);
+    const float start = envelopeVal;
+
+    for (int i = 0; i < length; ++i)
+        destination[i] = start + rate * static_cast<float>(i + 1);
+
+    if (length == segmentLength)
+    {
+        destination[length - 1] = limit;
+        envelopeVal = limit;
+        goToNextState();
+    }
+    else
+    {
+        envelopeVal = destination[length - 1];
+    }
+
+    return length;
+}
+
+void BlockEnvelope::recalculateRates() noexcept
+{
+    auto getRate = [this](float distance, float timeInSeconds)
+    {
+        return timeInSeconds > 0.0f ? static_cast<float>(distance / (timeInSeconds * sampleRate)) : -1.0f;
+    };
+
+    attackRate = getRate(1.0f, parameters.attack);
+    decayRate = getRate(1.0f - parameters.sustain, parameters.decay);
+    releaseRate = getRate(parameters.sustain, parameters.release);
+
+    if ((state == State::attack && attackRate <= 0.0f)
+        || (state == State::decay && (decayRate <= 0.0f || envelopeVal <= parameters.sustain))
+        || (state == State::release && releaseRate <= 0.0f))
+    {
+        goToNextState();
+    }
+}
+
+void BlockEnvelope::goToNextState() noexcept
+{
+    if (state == State::attack)
+        state = (decayRate > 0.0f ? State::decay : State::sustain);
+    else if (state == State::decay)
+        state = State::sustain;
+    else if (state == State::release)
+        reset();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+
+//ADSR envelope rendered a whole block at a time.
+//It follows the same segments and rates of juce::ADSR (linear attack, decay and release),
+//but instead of branching at every sample it finds how many samples are left in the current
+//segment and fills them with a single ramp, which the compiler can vectorise.
+class BlockEnvelope
+{
+public:
+
+    void setSampleRate(double newSampleRate);
+
+    void setParameters(const juce::ADSR::Parameters& newParameters);
+
+    void noteOn() noexcept;
+    void noteOff() noexcept;
+
+    void reset() noexcept;
+
+    bool isActive() const noexcept { return state != State::idle; }
+
+    //Last rendered value
+    float getCurrentValue() const noexcept { return envelopeVal; }
+
+    //In the release and below level: it will only get quieter until the next note
+    bool isReleasedBelow(float level) const noexcept { return (state == State::release && envelopeVal < level) || state == State::idle; }
+
+    //Fill destination with the next numSamples values of the envelope
+    void renderNextBlock(float* destination, int numSamples) noexcept;
+
+
+private:
+
+    enum class State { idle, attack, decay, sustain, release };
+
+    void recalculateRates() noexcept;
+    void goToNextState() noexcept;
+
+    //Linear segment from envelopeVal towards limit, moving by rate at every sample.
+    //Returns the number of samples written (the segment may end inside the block).
+    int renderSegment(float* destination, int numSamples, float rate, float limit) noexcept;
+
+    State state = State::idle;
+    juce::ADSR::Parameters parameters;
+
+    double sampleRate = 44100.0;
+    float envelopeVal = 0.0f;
+    float attackRate = 0.0f;
+    float decayRate = 0.0f;
+    float releaseRate = 0.0f;
+
+};
@@ -0,0 +1,124 @@
+#include "BusChorus.h"
+#include <algorithm>
+#include <cmath>
+
+
+void BusChorus::prepare(double newSampleRate, int numChannels)
+{
+    sampleRate = newSampleRate;
+
+    //Longest delay, plus the samples after the read position used by the interpolation
+    const int maxDelaySamples = (int) std::ceil((maxDelayMs + maxDepthMs) * 0.001 * sampleRate) + 4;
+    const int length = juce::nextPowerOfTwo(maxDelaySamples + chunkSize);
+    mask = length - 1;
+
+    channels.resize((size_t) numChannels);
+    for (auto& channel : channels)
+        channel.line.assign((size_t) length, 0.0f);
+
+    reset();
+}
+
+void BusChorus::reset() noexcept
+{
+    for (auto& channel : channels)
+    {
+        std::fill(channel.line.begin(), channel.line.end(), 0.0f);
+        channel.writePosition = 0;
+    }
+
+    lfoPhase = 0.0;
+    hasLastValues = false;
+}
+
+float BusChorus::getDelaySamples(double phase, float delay, float depth) const noexcept
+{
+    const double centreMs = minDelayMs + (double) delay * (maxDelayMs - minDelayMs);
+    const double depthMs = (double) depth * maxDepthMs;
+
+    //The delay swings between centre - depth and centre + depth, never below the minimum
+    const double delayMs = juce::jmax(minDelayMs, centreMs + depthMs * std::sin(juce::MathConstants<double>::twoPi * phase));
+    return (float) (delayMs * 0.001 * sampleRate);
+}
+
+void BusChorus::process(juce::AudioBuffer<float>& buffer, int numSamples, float delay, float depth, float mix) noexcept
+{
+    if (numSamples <= 0 || channels.empty())
+        return;
+
+    if (!hasLastValues)
+    {
+        lastDelay = delay;
+        lastDepth = depth;
+        lastMix = mix;
+        hasLastValues = true;
+    }
+
+    //Block-rate LFO: its value at both ends of the block, the delay ramps in between
+    const double phaseIncrement = lfoRateHz * numSamples / sampleRate;
+    const float mixStep = (mix - lastMix) / (float) numSamples;
+
+    const int numChannels = juce::jmin(buffer.getNumChannels(), (int) channels.size());
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        //The channels are a quarter of a cycle apart, for a wider sound
+        const double phase = lfoPhase + 0.25 * channel;
+        const float delayStart = getDelaySamples(phase, lastDelay, lastDepth);
+        const float delayEnd = getDelaySamples(phase + phaseIncrement, delay, depth);
+
+        processChannel(channels[(size_t) channel], buffer.getWritePointer(channel), numSamples,
+                       delayStart, (delayEnd - delayStart) / (float) numSamples, lastMix, mixStep);
+    }
+
+    lfoPhase = std::fmod(lfoPhase + phaseIncrement, 1.0);
+    lastDelay = delay;
+    lastDepth = depth;
+    lastMix = mix;
+}
+
+void BusChorus::processChannel(Channel& channel, float* samples, int numSamples,
+                               float delayStart, float delayStep, float mixStart, float mixStep) noexcept
+{
+    float* line = channel.line.data();
+
+    float x0[chunkSize], x1[chunkSize], x2[chunkSize], x3[chunkSize], fraction[chunkSize];
+
+    for (int offset = 0; offset < numSamples; offset += chunkSize)
+    {
+        const int count = juce::jmin(chunkSize, numSamples - offset);
+        const int writePosition = channel.writePosition;
+
+        //Written first: the shortest delay reads samples of this chunk
+        for (int i = 0; i < count; ++i)
+            line[(writePosition + i) & mask] = samples[offset + i];
+
+        //Gather the four points around every read position
+        for (int i = 0; i < count; ++i)
+        {
+            const float delaySamples = delayStart + delayStep * (float) (offset + i);
+            const float position = (float) (writePosition + i) - delaySamples;
+            const int index = (int) std::floor(position);
+
+            fraction[i] = position - (float) index;
+            x0[i] = line[(index - 1) & mask];
+            x1[i] = line[index & mask];
+            x2[i] = line[(index + 1) & mask];
+            x3[i] = line[(index + 2) & mask];
+        }
+
+        //Hermite interpolation and mix, no branches nor memory indirections
+        for (int i = 0; i < count; ++i)
+        {
+            const float c1 = 0.5f * (x2[i] - x0[i]);
+            const float c2 = x0[i] - 2.5f * x1[i] + 2.0f * x2[i] - 0.5f * x3[i];
+            const float c3 = 0.5f * (x3[i] - x0[i]) + 1.5f * (x1[i] - x2[i]);
+            const float f = fraction[i];
+            const float wet = ((c3 * f + c2) * f + c1) * f + x1[i];
+
+            const float mix = mixStart + mixStep * (float) (offset + i);
+            samples[offset + i] += mix * wet;
+        }
+
+        channel.writePosition = (writePosition + count) & mask;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <vector>
+
+
+//Chorus (modulated delay) on the summed output of the voices, driven by MD_DELAY, MD_DEPTH and MD_MIX:
+//output = dry + mix * (dry delayed by delay + depth * LFO), like the ModDelay of DDSP.
+//The LFO is evaluated once per block and the delay ramps linearly in between (from where the previous block
+//ended, so a change of MD_DELAY or MD_DEPTH does not make the read position jump); the delayed samples are
+//read with a 4-point Hermite interpolation, gathered per chunk, then computed in a loop the compiler
+//vectorises. The cost does not depend on the number of voices.
+class BusChorus
+{
+public:
+
+    //Allocates (prepareToPlay)
+    void prepare(double sampleRate, int numChannels);
+
+    void reset() noexcept;
+
+    //Audio thread: process the first numSamples samples of the buffer in place.
+    //delay, depth and mix are the normalised MD_DELAY, MD_DEPTH and MD_MIX
+    void process(juce::AudioBuffer<float>& buffer, int numSamples, float delay, float depth, float mix) noexcept;
+
+    static constexpr double minDelayMs = 1.0;
+    static constexpr double maxDelayMs = 30.0;
+    static constexpr double maxDepthMs = 10.0;
+    static constexpr double lfoRateHz = 0.8;
+
+
+private:
+
+    //Samples gathered and interpolated together
+    static constexpr int chunkSize = 64;
+
+    struct Channel
+    {
+        std::vector<float> line; //power of two length
+        int writePosition = 0;
+    };
+
+    //Delay (samples) at the given LFO phase (cycles)
+    float getDelaySamples(double phase, float delay, float depth) const noexcept;
+
+    void processChannel(Channel& channel, float* samples, int numSamples,
+                        float delayStart, float delayStep, float mixStart, float mixStep) noexcept;
+
+    std::vector<Channel> channels;
+    int mask = 0;
+
+    double sampleRate = 44100.0;
+    double lfoPhase = 0.0; //cycles
+
+    //Values at the end of the previous block, where the ramps of the next one start
+    float lastDelay = 0.0f;
+    float lastDepth = 0.0f;
+    float lastMix = 0.0f;
+    bool hasLastValues = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BusChorus)
+};
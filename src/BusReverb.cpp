@@ -0,0 +1,87 @@
+#include "BusReverb.h"
+#include <cmath>
+
+
+BusReverb::BusReverb()
+    : BackgroundBuilder("Reverb builder")
+{
+    juce::Random random;
+    for (float& sample : noise)
+        sample = random.nextFloat() * 2 - 1; // To have [-1, 1) range
+    noise[0] = 0.0f; //set to zero first sample
+
+    float energy = 0.0f;
+    for (float sample : noise)
+        energy += sample * sample;
+
+    for (float& sample : noise)
+        sample /= std::sqrt(energy);
+
+    startThread();
+}
+
+BusReverb::~BusReverb()
+{
+    stopThread(2000);
+}
+
+void BusReverb::prepare(double newSampleRate, int numChannels)
+{
+    convolver.prepare(numChannels, partitionSize, (irLength + partitionSize - 1) / partitionSize);
+    convolver.setImpulseResponse(nullptr, 0);
+    crossfadeSamples = juce::roundToInt(crossfadeSeconds * newSampleRate);
+
+    //Responses built for the old rate are dropped, and the current parameters built again
+    slots.reset(newSampleRate);
+
+    if (lastGain >= 0.0f)
+        requestBuild();
+}
+
+void BusReverb::setParameters(float gain, float decay) noexcept
+{
+    if (gain == lastGain && decay == lastDecay)
+        return;
+
+    lastGain = gain;
+    lastDecay = decay;
+
+    requestedGain.store(gain);
+    requestedDecay.store(decay);
+    requestBuild();
+}
+
+void BusReverb::process(juce::AudioBuffer<float>& buffer, int numSamples) noexcept
+{
+    //A new response is swapped in once the previous crossfade is over
+    if (!convolver.isCrossfading())
+    {
+        slots.releasePrevious();
+
+        if (slots.swapIn(true))
+            convolver.setImpulseResponse(&slots.getActive()->response, crossfadeSamples);
+    }
+
+    const int numChannels = juce::jmin(buffer.getNumChannels(), convolver.getNumChannels());
+    for (int channel = 0; channel < numChannels; ++channel)
+        convolver.processAdding(channel, buffer.getWritePointer(channel), numSamples);
+}
+
+void BusReverb::build()
+{
+    const float gain = requestedGain.load();
+    const float decay = requestedDecay.load();
+    const double rate = slots.getSampleRate();
+
+    //Recompute the impulse response
+    for (int i = 0; i < irLength; ++i)
+    {
+        const float time = static_cast<float>(i / rate);
+        impulseResponse[(size_t) i] = gain * std::exp(-decay * time) * noise[(size_t) i];
+    }
+
+    Slot& slot = slots.getFreeSlot();
+    slot.response.build(impulseResponse.data(), irLength, partitionSize);
+    slot.sampleRate = rate;
+    slots.publish();
+}
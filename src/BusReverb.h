@@ -0,0 +1,67 @@
+#pragma once
+#include "PartitionedConvolver.h"
+#include "BackgroundBuilder.h"
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <atomic>
+
+
+//Convolution reverb on the summed output of the voices (the reverb of the synth in the network:
+//decaying noise, gain * exp(-decay * t)), so it costs the same whatever the number of voices.
+//The impulse response is rebuilt on a background thread when REV_GAIN or REV_DEC move, and swapped in
+//with a crossfade: the audio thread never allocates nor computes a response.
+//The reverberated part is delayed by PartitionedConvolver::getBlockSize() samples.
+class BusReverb : private BackgroundBuilder
+{
+public:
+
+    BusReverb();
+    ~BusReverb() override;
+
+    //Allocates (prepareToPlay)
+    void prepare(double sampleRate, int numChannels);
+
+    //Audio thread: ask for the response of these parameters (does nothing if they did not change)
+    void setParameters(float gain, float decay) noexcept;
+
+    //Offline rendering: wait until the response of the last parameters asked for is built (the next process()
+    //swaps it in). False if it took longer than timeoutMs
+    bool waitForResponse(int timeoutMs) const { return waitForBuild(timeoutMs); }
+
+    //Audio thread: add the reverberation to the first numSamples samples of the buffer
+    void process(juce::AudioBuffer<float>& buffer, int numSamples) noexcept;
+
+    static constexpr int irLength = 400; //samples
+    static constexpr int partitionSize = 128;
+    static constexpr double crossfadeSeconds = 0.05;
+
+
+private:
+
+    struct Slot
+    {
+        PartitionedImpulseResponse response;
+        double sampleRate = 0.0;
+    };
+
+    void build() override;
+
+    //One published, the one played and the one fading out, plus one for the builder
+    SlotHandover<Slot, 4> slots;
+
+    //Requested parameters, written by the audio thread
+    std::atomic<float> requestedGain{ 0.0f };
+    std::atomic<float> requestedDecay{ 0.0f };
+
+    float lastGain = -1.0f; //only used by the audio thread
+    float lastDecay = -1.0f;
+
+    //White noise in [-1, 1), scaled to unit energy: the gain is the level of the reverb relative to the dry sound
+    std::array<float, irLength> noise{};
+    std::array<float, irLength> impulseResponse{}; //builder thread
+
+    PartitionedConvolver convolver;
+    int crossfadeSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BusReverb)
+};
@@ -0,0 +1,291 @@
+#include "EstimationCache.h"
+#include <algorithm>
+#include <cstring>
+
+
+namespace
+{
+    //"NSPE" and the version of the record layout
+    constexpr int recordMagic = 0x4550534e;
+    constexpr int recordVersion = 1;
+
+    const juce::String recordExtension = ".nspe";
+
+    constexpr juce::uint64 prime1 = 11400714785074694791ULL;
+    constexpr juce::uint64 prime2 = 14029467366897019727ULL;
+    constexpr juce::uint64 prime3 = 1609587929392839161ULL;
+    constexpr juce::uint64 prime4 = 9650029242287828579ULL;
+    constexpr juce::uint64 prime5 = 2870177450012600261ULL;
+
+    inline juce::uint64 rotateLeft(juce::uint64 x, int bits) noexcept
+    {
+        return (x << bits) | (x >> (64 - bits));
+    }
+
+    inline juce::uint64 read64(const juce::uint8* p) noexcept
+    {
+        juce::uint64 value;
+        std::memcpy(&value, p, sizeof(value));
+        return juce::ByteOrder::swapIfBigEndian(value);
+    }
+
+    inline juce::uint32 read32(const juce::uint8* p) noexcept
+    {
+        juce::uint32 value;
+        std::memcpy(&value, p, sizeof(value));
+        return juce::ByteOrder::swapIfBigEndian(value);
+    }
+
+    inline juce::uint64 round(juce::uint64 accumulator, juce::uint64 input) noexcept
+    {
+        accumulator += input * prime2;
+        return rotateLeft(accumulator, 31) * prime1;
+    }
+
+    inline juce::uint64 mergeRound(juce::uint64 accumulator, juce::uint64 value) noexcept
+    {
+        accumulator ^= round(0, value);
+        return accumulator * prime1 + prime4;
+    }
+}
+
+
+EstimationCache& EstimationCache::getInstance()
+{
+    static EstimationCache cache(juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                                     .getChildFile("Korpsvart")
+                                     .getChildFile("NeuralSynthParams")
+                                     .getChildFile("EstimationCache"));
+    return cache;
+}
+
+EstimationCache::EstimationCache(const juce::File& directory, juce::int64 maxBytes)
+    : directory(directory), maxBytes(maxBytes)
+{
+}
+
+EstimationCache::Record EstimationCache::makeRecord(const InferenceBackend::OutputLayout& layout, const float* values)
+{
+    Record record;
+    record.reserve(layout.entries.size());
+
+    for (const auto& entry : layout.entries)
+        record.emplace_back(entry.name, std::vector<float>(values + entry.offset, values + entry.offset + entry.size));
+
+    return record;
+}
+
+bool EstimationCache::readRecord(const Record& record, const InferenceBackend::OutputLayout& layout, float* values)
+{
+    for (const auto& entry : layout.entries)
+    {
+        auto stored = std::find_if(record.begin(), record.end(), [&](const Record::value_type& output) { return output.first == entry.name; });
+
+        if (stored == record.end() || (int) stored->second.size() != entry.size)
+            return false;
+
+        std::copy(stored->second.begin(), stored->second.end(), values + entry.offset);
+    }
+
+    return true;
+}
+
+juce::uint64 EstimationCache::hash(const void* data, size_t numBytes, juce::uint64 seed) noexcept
+{
+    const auto* p = static_cast<const juce::uint8*>(data);
+    const auto* end = p + numBytes;
+
+    juce::uint64 h;
+
+    if (numBytes >= 32)
+    {
+        //Four independent lanes over 32-byte stripes
+        juce::uint64 v1 = seed + prime1 + prime2;
+        juce::uint64 v2 = seed + prime2;
+        juce::uint64 v3 = seed;
+        juce::uint64 v4 = seed - prime1;
+
+        for (; p + 32 <= end; p += 32)
+        {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+
+        h = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    }
+    else
+    {
+        h = seed + prime5;
+    }
+
+    h += (juce::uint64) numBytes;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= round(0, read64(p));
+        h = rotateLeft(h, 27) * prime1 + prime4;
+    }
+
+    if (p + 4 <= end)
+    {
+        h ^= (juce::uint64) read32(p) * prime1;
+        h = rotateLeft(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+
+    for (; p < end; ++p)
+    {
+        h ^= *p * prime5;
+        h = rotateLeft(h, 11) * prime1;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+juce::String EstimationCache::makeKey(const float* samples, size_t numSamples, const juce::String& modelChecksum,
+                                     const juce::String& modelVariant)
+{
+    const juce::uint64 audioHash = hash(samples, numSamples * sizeof(float));
+
+    juce::String key = juce::String::toHexString((juce::int64) audioHash).paddedLeft('0', 16) + "-" + modelChecksum.substring(0, 16);
+
+    if (modelVariant.isNotEmpty())
+        key << "-" << modelVariant;
+
+    return key;
+}
+
+void EstimationCache::fitToClip(std::vector<float>& audio, int clipSamples)
+{
+    audio.resize((size_t) clipSamples, 0.0f);
+}
+
+juce::String EstimationCache::getModelVariant(InferenceBackend::Precision precision)
+{
+    return precision == InferenceBackend::Precision::int8 ? "int8" : "";
+}
+
+juce::File EstimationCache::getRecordFile(const juce::String& key) const
+{
+    return directory.getChildFile(key + recordExtension);
+}
+
+bool EstimationCache::load(const juce::String& key, Record& record) const
+{
+    const juce::File file = getRecordFile(key);
+
+    juce::MemoryBlock data;
+    if (!file.loadFileAsData(data))
+        return false;
+
+    juce::MemoryInputStream input(data, false);
+
+    if (input.readInt() != recordMagic || input.readInt() != recordVersion)
+        return false;
+
+    const int numEntries = input.readCompressedInt();
+    if (numEntries < 0)
+        return false;
+
+    record.clear();
+
+    for (int i = 0; i < numEntries; ++i)
+    {
+        const juce::String name = input.readString();
+        const int numValues = input.readCompressedInt();
+
+        //Truncated or damaged file (e.g. deleted while being read)
+        if (numValues < 0 || input.getNumBytesRemaining() < (juce::int64) numValues * (juce::int64) sizeof(float))
+            return false;
+
+        std::vector<float> values((size_t) numValues);
+        for (auto& value : values)
+            value = input.readFloat();
+
+        record.emplace_back(name.toStdString(), std::move(values));
+    }
+
+    //Least recently used first when trimming
+    file.setLastModificationTime(juce::Time::getCurrentTime());
+
+    return true;
+}
+
+bool EstimationCache::store(const juce::String& key, const Record& record)
+{
+    if (!directory.createDirectory())
+        return false;
+
+    juce::MemoryOutputStream output;
+    output.writeInt(recordMagic);
+    output.writeInt(recordVersion);
+    output.writeCompressedInt((int) record.size());
+
+    for (const auto& entry : record)
+    {
+        output.writeString(juce::String(entry.first));
+        output.writeCompressedInt((int) entry.second.size());
+
+        for (float value : entry.second)
+            output.writeFloat(value);
+    }
+
+    //Written next to the record and renamed: other processes never read half a record
+    const juce::File file = getRecordFile(key);
+    juce::TemporaryFile temporary(file);
+
+    if (!temporary.getFile().replaceWithData(output.getData(), output.getDataSize())
+        || !temporary.overwriteTargetFileWithTemporary())
+        return false;
+
+    trim();
+    return true;
+}
+
+void EstimationCache::trim()
+{
+    std::lock_guard<std::mutex> scopedLock(trimLock);
+
+    struct RecordFile
+    {
+        juce::File file;
+        juce::int64 size;
+        juce::Time lastUsed;
+    };
+
+    std::vector<RecordFile> files;
+    juce::int64 totalBytes = 0;
+
+    for (const auto& entry : juce::RangedDirectoryIterator(directory, false, "*" + recordExtension, juce::File::findFiles))
+    {
+        files.push_back({ entry.getFile(), entry.getFileSize(), entry.getModificationTime() });
+        totalBytes += entry.getFileSize();
+    }
+
+    if (totalBytes <= maxBytes)
+        return;
+
+    std::sort(files.begin(), files.end(), [](const RecordFile& a, const RecordFile& b) { return a.lastUsed < b.lastUsed; });
+
+    for (const auto& record : files)
+    {
+        if (totalBytes <= maxBytes)
+            break;
+
+        //Another process may have deleted it already
+        if (record.file.deleteFile())
+            totalBytes -= record.size;
+    }
+}
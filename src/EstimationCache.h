@@ -0,0 +1,71 @@
+#pragma once
+#include "InferenceBackend.h"
+#include <juce_core/juce_core.h>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+//Estimated parameters stored on disk, keyed by the content of the audio (decoded and resampled for the network)
+//and the checksum of the model: estimating the same clip again with the same model reads a small file
+//instead of running the network. One compact binary record per clip, in a folder of the user settings
+//shared by all the plugin instances and the command line tools. The least recently used records are
+//deleted when the folder grows past the size limit.
+class EstimationCache
+{
+public:
+
+    //The outputs of the network: (name, values) for every entry of the output dict
+    using Record = std::vector<std::pair<std::string, std::vector<float>>>;
+
+    //Conversions from and to the flat outputs of a backend (one clip).
+    //readRecord fails if the record does not have every output of the layout, with the same size
+    static Record makeRecord(const InferenceBackend::OutputLayout& layout, const float* values);
+    static bool readRecord(const Record& record, const InferenceBackend::OutputLayout& layout, float* values);
+
+    //Default cache, in the user application data folder
+    static EstimationCache& getInstance();
+
+    explicit EstimationCache(const juce::File& directory, juce::int64 maxBytes = defaultMaxBytes);
+
+    //Key of a clip: 64-bit xxHash of the samples, the beginning of the model checksum,
+    //and how the model runs when that changes the results (e.g. "int8")
+    static juce::String makeKey(const float* samples, size_t numSamples, const juce::String& modelChecksum,
+                                const juce::String& modelVariant = {});
+
+    //The clip the network runs on and the key is made from, in the plugin and in the tools alike (so they share
+    //their records): the decoded audio padded with zeros or cropped to the length the network was trained on
+    static void fitToClip(std::vector<float>& audio, int clipSamples);
+
+    //The model variant of makeKey for a precision
+    static juce::String getModelVariant(InferenceBackend::Precision precision);
+
+    //The record stored with this key, if any (and marks it as recently used)
+    bool load(const juce::String& key, Record& record) const;
+
+    //Store a record, replacing the one with the same key, then delete the oldest records beyond the size limit.
+    //False if it cannot be written
+    bool store(const juce::String& key, const Record& record);
+
+    juce::File getDirectory() const { return directory; }
+
+    static constexpr juce::int64 defaultMaxBytes = 16 * 1024 * 1024;
+
+    //xxHash64 of a block of memory
+    static juce::uint64 hash(const void* data, size_t numBytes, juce::uint64 seed = 0) noexcept;
+
+
+private:
+
+    juce::File getRecordFile(const juce::String& key) const;
+
+    void trim();
+
+    const juce::File directory;
+    const juce::int64 maxBytes;
+
+    std::mutex trimLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EstimationCache)
+};
@@ -0,0 +1,522 @@
+#include "FreezeSampler.h"
+#include "SynthVoice.h"
+#include "SynthSound.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+
+namespace
+{
+    bool operator== (const ADSRValues& a, const ADSRValues& b) noexcept
+    {
+        return a.attack == b.attack && a.decay == b.decay && a.sustain == b.sustain && a.release == b.release;
+    }
+
+    //Seconds until an envelope reaches its sustain level (the voices scale the stored values by 4)
+    double getAttackDecaySeconds(const ADSRValues& adsr) noexcept
+    {
+        return 4.0 * ((double) adsr.attack + (double) adsr.decay);
+    }
+
+    void quantise(const std::vector<float>& samples, float scale, std::vector<std::int16_t>& destination)
+    {
+        destination.resize(samples.size());
+
+        for (size_t i = 0; i < samples.size(); ++i)
+            destination[i] = (std::int16_t) juce::roundToInt(samples[i] * scale);
+    }
+}
+
+
+FreezeSettings FreezeSettings::fromSnapshot(const SynthParameterSnapshot& snapshot) noexcept
+{
+    FreezeSettings settings;
+    settings.oscMix1 = snapshot.oscMix1.end;
+    settings.oscMix2 = snapshot.oscMix2.end;
+    settings.cutFloor = snapshot.cutFloor.end;
+    settings.cutPeak = snapshot.cutPeak.end;
+    settings.qFilt = snapshot.qFilt.end;
+    settings.f0Mult = snapshot.f0Mult;
+    settings.adsr1 = snapshot.adsr1;
+    settings.adsr2 = snapshot.adsr2;
+    settings.adsrC = snapshot.adsrC;
+    return settings;
+}
+
+SynthParameterSnapshot FreezeSettings::toSnapshot(int numSamples) const noexcept
+{
+    SynthParameterSnapshot snapshot;
+    snapshot.numSamples = numSamples;
+    snapshot.oscMix1 = { oscMix1, oscMix1 };
+    snapshot.oscMix2 = { oscMix2, oscMix2 };
+    snapshot.cutFloor = { cutFloor, cutFloor };
+    snapshot.cutPeak = { cutPeak, cutPeak };
+    snapshot.qFilt = { qFilt, qFilt };
+    snapshot.f0Mult = f0Mult;
+    snapshot.adsr1 = adsr1;
+    snapshot.adsr2 = adsr2;
+    snapshot.adsrC = adsrC;
+
+    //The tails end at -100 dB
+    snapshot.cullingThreshold = juce::Decibels::decibelsToGain(-100.0f);
+    return snapshot;
+}
+
+bool FreezeSettings::operator== (const FreezeSettings& other) const noexcept
+{
+    return oscMix1 == other.oscMix1 && oscMix2 == other.oscMix2
+        && cutFloor == other.cutFloor && cutPeak == other.cutPeak && qFilt == other.qFilt
+        && f0Mult == other.f0Mult
+        && adsr1 == other.adsr1 && adsr2 == other.adsr2 && adsrC == other.adsrC;
+}
+
+
+bool FrozenNote::render(int newRootNote, const FreezeSettings& settings, double sampleRate, const std::atomic<bool>& abandon)
+{
+    constexpr int blockSize = 512;
+
+    rootNote = newRootNote;
+
+    //A synthesiser with a single voice, exactly as the plugin plays the note
+    const SynthParameterSnapshot parameters = settings.toSnapshot(blockSize);
+
+    juce::Synthesiser synth;
+    synth.addSound(new SynthSound());
+
+    auto* voice = new SynthVoice(&parameters);
+    voice->prepareToPlay(sampleRate, blockSize, 1);
+    voice->updateADSRA1(settings.adsr1.attack, settings.adsr1.decay, settings.adsr1.sustain, settings.adsr1.release);
+    voice->updateADSRA2(settings.adsr2.attack, settings.adsr2.decay, settings.adsr2.sustain, settings.adsr2.release);
+    voice->updateADSRc(settings.adsrC.attack, settings.adsrC.decay, settings.adsrC.sustain, settings.adsrC.release);
+    synth.addVoice(voice);
+    synth.setCurrentPlaybackSampleRate(sampleRate);
+
+    juce::AudioBuffer<float> buffer(1, blockSize);
+    juce::MidiBuffer noMidi;
+
+    auto renderInto = [&](float* destination, int numSamples) {
+        buffer.clear();
+        synth.renderNextBlock(buffer, noMidi, 0, numSamples);
+        std::copy(buffer.getReadPointer(0), buffer.getReadPointer(0) + numSamples, destination);
+    };
+
+    //The loop starts once the three envelopes have reached their sustain level
+    const double attackDecaySeconds = juce::jmax(getAttackDecaySeconds(settings.adsr1), getAttackDecaySeconds(settings.adsr2),
+                                                 getAttackDecaySeconds(settings.adsrC));
+
+    const int loopCrossfade = juce::roundToInt(FrozenNoteSet::loopCrossfadeSeconds * sampleRate);
+    const int loopLength = juce::roundToInt(FrozenNoteSet::loopSeconds * sampleRate);
+    loopStart = juce::jmax(loopCrossfade, juce::roundToInt(juce::jmin(FrozenNoteSet::maxSustainSeconds, attackDecaySeconds) * sampleRate));
+
+    const int loopEnd = loopStart + loopLength;
+    std::vector<float> sustainSamples((size_t) loopEnd + 1, 0.0f);
+
+    synth.noteOn(1, rootNote, 1.0f);
+
+    for (int position = 0; position < loopEnd; position += blockSize)
+    {
+        if (abandon.load())
+            return false;
+
+        renderInto(sustainSamples.data() + position, juce::jmin(blockSize, loopEnd - position));
+    }
+
+    //The end of the loop fades into the samples before its start, so jumping back to the start is seamless
+    for (int i = 0; i < loopCrossfade; ++i)
+    {
+        const float fade = ((float) i + 0.5f) / (float) loopCrossfade;
+        float& sample = sustainSamples[(size_t) (loopEnd - loopCrossfade + i)];
+        sample += fade * (sustainSamples[(size_t) (loopStart - loopCrossfade + i)] - sample);
+    }
+
+    sustainSamples[(size_t) loopEnd] = sustainSamples[(size_t) loopStart];
+
+    //The tail, until the voice ends below the culling threshold
+    synth.noteOff(1, rootNote, 0.0f, true);
+
+    const int maxReleaseLength = juce::roundToInt(FrozenNoteSet::maxReleaseSeconds * sampleRate);
+    std::vector<float> releaseSamples;
+
+    while (voice->isVoiceActive() && (int) releaseSamples.size() < maxReleaseLength)
+    {
+        if (abandon.load())
+            return false;
+
+        const size_t start = releaseSamples.size();
+        const int count = juce::jmin(blockSize, maxReleaseLength - (int) start);
+
+        releaseSamples.resize(start + (size_t) count);
+        renderInto(releaseSamples.data() + start, count);
+    }
+
+    releaseSamples.push_back(0.0f);
+
+    //16 bits over the peak of the whole note
+    float peak = 0.0f;
+    for (const float sample : sustainSamples)
+        peak = juce::jmax(peak, std::abs(sample));
+    for (const float sample : releaseSamples)
+        peak = juce::jmax(peak, std::abs(sample));
+
+    gain = peak / 32767.0f;
+    const float scale = peak > 0.0f ? 32767.0f / peak : 0.0f;
+
+    quantise(sustainSamples, scale, sustain);
+    quantise(releaseSamples, scale, release);
+    return true;
+}
+
+float FrozenNote::getSustainSample(double position) const noexcept
+{
+    const int loopEnd = (int) sustain.size() - 1;
+
+    if (position >= loopEnd)
+        position = loopStart + std::fmod(position - loopStart, (double) (loopEnd - loopStart));
+
+    const int index = (int) position;
+    const float fraction = (float) (position - index);
+    const float first = sustain[(size_t) index];
+
+    return gain * (first + fraction * ((float) sustain[(size_t) index + 1] - first));
+}
+
+float FrozenNote::getReleaseSample(double position) const noexcept
+{
+    if (position >= getReleaseLength())
+        return 0.0f;
+
+    const int index = (int) position;
+    const float fraction = (float) (position - index);
+    const float first = release[(size_t) index];
+
+    return gain * (first + fraction * ((float) release[(size_t) index + 1] - first));
+}
+
+
+void FrozenNoteSet::prepare(const FreezeSettings& newSettings, double newSampleRate, int newNoteStep)
+{
+    settings = newSettings;
+    sampleRate = newSampleRate;
+    noteStep = juce::jlimit(1, 12, newNoteStep);
+
+    notes.resize((size_t) ((highestNote - lowestNote) / noteStep + 1));
+
+    ready = std::make_unique<std::atomic<bool>[]>(notes.size());
+    numReady.store(0);
+}
+
+int FrozenNoteSet::getIndex(int midiNote) const noexcept
+{
+    const int index = juce::roundToInt((midiNote - lowestNote) / (double) noteStep);
+    return juce::jlimit(0, (int) notes.size() - 1, index);
+}
+
+void FrozenNoteSet::setReady(int index) noexcept
+{
+    ready[(size_t) index].store(true);
+    ++numReady;
+}
+
+const FrozenNote* FrozenNoteSet::getNote(int midiNote) const noexcept
+{
+    if (notes.empty())
+        return nullptr;
+
+    const int index = getIndex(midiNote);
+    return ready[(size_t) index].load() ? &notes[(size_t) index] : nullptr;
+}
+
+const FrozenNote* FrozenNoteSet::getNearestNote(int midiNote) const noexcept
+{
+    if (notes.empty())
+        return nullptr;
+
+    const int index = getIndex(midiNote);
+
+    for (int distance = 0; distance < (int) notes.size(); ++distance)
+    {
+        if (index - distance >= 0 && ready[(size_t) (index - distance)].load())
+            return &notes[(size_t) (index - distance)];
+
+        if (index + distance < (int) notes.size() && ready[(size_t) (index + distance)].load())
+            return &notes[(size_t) (index + distance)];
+    }
+
+    return nullptr;
+}
+
+double FrozenNoteSet::getPlaybackRate(const FrozenNote& note, int midiNote) noexcept
+{
+    return std::exp2((midiNote - note.rootNote) / 12.0);
+}
+
+
+void FrozenNotePlayer::start(int newMidiNote) noexcept
+{
+    midiNote = newMidiNote;
+    playing = true;
+    released = false;
+    elapsed = 0.0;
+    releaseElapsed = 0.0;
+    set = nullptr;
+    weight = 1.0f;
+}
+
+void FrozenNotePlayer::release() noexcept
+{
+    if (released)
+        return;
+
+    released = true;
+    releaseElapsed = 0.0;
+}
+
+float FrozenNotePlayer::getSample(const FrozenNote& note, double rate, double sampleRate) const noexcept
+{
+    if (!released)
+        return note.getSustainSample(elapsed * rate);
+
+    //Short crossfade from where the note is into the tail
+    const float tail = note.getReleaseSample(releaseElapsed * rate);
+    const double crossfade = FrozenNoteSet::releaseCrossfadeSeconds * sampleRate;
+
+    if (releaseElapsed >= crossfade)
+        return tail;
+
+    const float held = note.getSustainSample(elapsed * rate);
+    return held + (float) (releaseElapsed / crossfade) * (tail - held);
+}
+
+bool FrozenNotePlayer::render(const SynthParameterSnapshot& parameters, float* output, int numSamples) noexcept
+{
+    const FrozenNoteSet* current = parameters.frozen;
+
+    if (!playing || current == nullptr)
+    {
+        playing = false;
+        return false;
+    }
+
+    //A new set fades in from the one the note played so far (a new note starts on the current set)
+    if (current != set)
+    {
+        weight = set == nullptr ? 1.0f : 0.0f;
+        set = current;
+    }
+
+    //Until the note is rendered in the current set, it plays the previous set or the nearest note rendered
+    const FrozenNote* note = current->getNote(midiNote);
+    const FrozenNote* fallback = parameters.frozenFadingOut != nullptr ? parameters.frozenFadingOut->getNote(midiNote) : nullptr;
+
+    if (fallback == nullptr)
+        fallback = current->getNearestNote(midiNote);
+
+    if (note == nullptr && fallback == nullptr)
+    {
+        playing = false;
+        return false;
+    }
+
+    if (note == nullptr)
+        weight = 0.0f;
+    else if (fallback == nullptr || fallback == note)
+        weight = 1.0f;
+
+    const double rate = note != nullptr ? FrozenNoteSet::getPlaybackRate(*note, midiNote) : 1.0;
+    const double fallbackRate = fallback != nullptr ? FrozenNoteSet::getPlaybackRate(*fallback, midiNote) : 1.0;
+    const float weightStep = (float) (1.0 / (FrozenNoteSet::crossfadeSeconds * current->sampleRate));
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float sample = weight > 0.0f ? getSample(*note, rate, current->sampleRate) : 0.0f;
+
+        if (weight < 1.0f)
+        {
+            const float previous = getSample(*fallback, fallbackRate, current->sampleRate);
+            sample = previous + weight * (sample - previous);
+
+            if (note != nullptr)
+                weight = juce::jmin(1.0f, weight + weightStep);
+        }
+
+        output[i] = sample;
+
+        elapsed += 1.0;
+        if (released)
+            releaseElapsed += 1.0;
+    }
+
+    //Over once the tail heard has ended
+    const FrozenNote& heard = weight > 0.0f ? *note : *fallback;
+    const double heardRate = weight > 0.0f ? rate : fallbackRate;
+
+    if (released && releaseElapsed * heardRate >= heard.getReleaseLength())
+        playing = false;
+
+    return playing;
+}
+
+
+FreezeBuilder::FreezeBuilder()
+    : BackgroundBuilder("Freeze builder"),
+      pool(juce::jlimit(1, 4, juce::SystemStats::getNumCpus() - 1))
+{
+    startThread();
+}
+
+FreezeBuilder::~FreezeBuilder()
+{
+    abandon.store(true);
+    stopThread(4000);
+}
+
+void FreezeBuilder::prepare(double newSampleRate)
+{
+    crossfadeSamples = juce::roundToInt(FrozenNoteSet::crossfadeSeconds * newSampleRate);
+    holdSamples = 0;
+
+    //Sets rendered for the old rate are dropped, and the current settings rendered again
+    slots.reset(newSampleRate);
+
+    if (hasRequested)
+    {
+        requests.getWriteBuffer() = lastRequest;
+        requests.publish();
+        requestBuild();
+    }
+}
+
+void FreezeBuilder::notePlayed(int midiNote) noexcept
+{
+    recentNotes[(size_t) nextRecentNote] = midiNote;
+    nextRecentNote = (nextRecentNote + 1) % (int) recentNotes.size();
+    numRecentNotes = juce::jmin(numRecentNotes + 1, (int) recentNotes.size());
+}
+
+void FreezeBuilder::requestSettings(const FreezeSettings& settings, int noteStep) noexcept
+{
+    noteStep = juce::jlimit(1, 12, noteStep);
+
+    if (hasRequested && settings == lastRequest.settings && noteStep == lastRequest.noteStep)
+        return;
+
+    lastRequest.settings = settings;
+    lastRequest.noteStep = noteStep;
+    hasRequested = true;
+
+    lastRequest.lowestPlayed = 0;
+    lastRequest.highestPlayed = -1;
+
+    for (int i = 0; i < numRecentNotes; ++i)
+    {
+        const int note = recentNotes[(size_t) i];
+        lastRequest.lowestPlayed = i == 0 ? note : juce::jmin(lastRequest.lowestPlayed, note);
+        lastRequest.highestPlayed = i == 0 ? note : juce::jmax(lastRequest.highestPlayed, note);
+    }
+
+    requests.getWriteBuffer() = lastRequest;
+    requests.publish();
+    requestBuild();
+}
+
+FreezeBuilder::FrozenNotes FreezeBuilder::update(int numSamples) noexcept
+{
+    //The previous set is released, and a new one swapped in, once the notes are done crossfading from it
+    if (holdSamples <= 0)
+    {
+        slots.releasePrevious();
+
+        if (slots.swapIn(true))
+            holdSamples = crossfadeSamples;
+    }
+
+    FrozenNotes notes;
+    notes.current = slots.getActive();
+    notes.fadingOut = slots.getPrevious();
+
+    //The notes crossfade from the previous set as they are rendered in the current one:
+    //it is held until the current set is complete, and for one crossfade after
+    if (notes.current != nullptr && !notes.current->isComplete())
+        holdSamples = crossfadeSamples;
+    else
+        holdSamples -= numSamples;
+
+    return notes;
+}
+
+void FreezeBuilder::build()
+{
+    //The set published last is not swapped in yet, and the audio thread holds the two others
+    while (!slots.hasFreeSlot())
+    {
+        if (threadShouldExit())
+            return;
+
+        wait(pollMilliseconds);
+    }
+
+    if (const Request* request = requests.read())
+    {
+        auto& set = slots.getFreeSlot();
+        set.prepare(request->settings, slots.getSampleRate(), request->noteStep);
+
+        render(set, *request);
+    }
+}
+
+void FreezeBuilder::render(FrozenNoteSet& set, const Request& request)
+{
+    //The notes played (all of them if none was) come first, then the others from the nearest
+    const bool anyPlayed = request.highestPlayed >= request.lowestPlayed;
+    const int first = anyPlayed ? set.getIndex(request.lowestPlayed) : 0;
+    const int last = anyPlayed ? set.getIndex(request.highestPlayed) : (int) set.notes.size() - 1;
+
+    auto getDistance = [first, last](int index) { return index < first ? first - index : juce::jmax(0, index - last); };
+
+    std::vector<int> order(set.notes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return getDistance(a) < getDistance(b); });
+
+    abandon.store(false);
+    notesLeft.store((int) order.size());
+    firstNotesLeft.store(last - first + 1);
+
+    for (const int index : order)
+    {
+        const int rootNote = FrozenNoteSet::lowestNote + index * set.noteStep;
+        const bool firstNote = getDistance(index) == 0;
+
+        pool.addJob([this, &set, index, rootNote, firstNote] {
+            if (set.notes[(size_t) index].render(rootNote, set.settings, set.sampleRate, abandon))
+                set.setReady(index);
+
+            if (firstNote)
+                firstNotesLeft.fetch_sub(1);
+
+            notesLeft.fetch_sub(1);
+            return juce::ThreadPoolJob::jobHasFinished;
+        });
+    }
+
+    //Every job is waited for, even abandoned: they write in the slot
+    bool published = false;
+
+    while (notesLeft.load() > 0)
+    {
+        if (!published && firstNotesLeft.load() == 0 && !abandon.load())
+        {
+            slots.publish();
+            published = true;
+        }
+
+        //Once published the set is finished, unless it is for the rate before prepare()
+        if (threadShouldExit() || (!published && isRequestPending()) || set.sampleRate != slots.getSampleRate())
+            abandon.store(true);
+
+        wait(5);
+    }
+
+    if (!published && !abandon.load())
+        slots.publish();
+}
@@ -0,0 +1,230 @@
+#pragma once
+#include "SynthParameters.h"
+#include "Mailbox.h"
+#include "BackgroundBuilder.h"
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+//Everything the sound of a note depends on: a voice renders the same samples for the same settings,
+//note and duration (the velocity and the pitch wheel are not used). The LFO is not part of it:
+//frozen notes are not modulated
+struct FreezeSettings
+{
+    float oscMix1 = 0.0f;
+    float oscMix2 = 0.0f;
+    float cutFloor = 0.0f;
+    float cutPeak = 0.0f;
+    float qFilt = 0.0f;
+    float f0Mult = 1.0f;
+
+    ADSRValues adsr1;
+    ADSRValues adsr2;
+    ADSRValues adsrC;
+
+    //The values at the end of the block (SynthParameterCache::getTargets() for the end of a ramp or a glide)
+    static FreezeSettings fromSnapshot(const SynthParameterSnapshot& snapshot) noexcept;
+
+    //Snapshot to render the notes with (no ramps, no wavetables, no modulation)
+    SynthParameterSnapshot toSnapshot(int numSamples) const noexcept;
+
+    bool operator== (const FreezeSettings& other) const noexcept;
+    bool operator!= (const FreezeSettings& other) const noexcept { return !(*this == other); }
+};
+
+
+//One note rendered by a SynthVoice: the attack and decay followed by a loop of the sustain,
+//and the release tail rendered from the sustain. Stored in 16 bits, scaled to the peak of the note
+struct FrozenNote
+{
+    int rootNote = 0;
+
+    //Attack, decay, then the loop [loopStart, size - 1), with one guard sample (the first of the loop)
+    std::vector<std::int16_t> sustain;
+    int loopStart = 0;
+
+    //Release tail from the note off, with one guard sample (0)
+    std::vector<std::int16_t> release;
+
+    float gain = 0.0f; //of one step of the samples
+
+    //Render the note with a voice of its own. False if it was abandoned (left half rendered)
+    bool render(int newRootNote, const FreezeSettings& settings, double sampleRate, const std::atomic<bool>& abandon);
+
+    //Linearly interpolated samples, position in samples of the note since the note on / the note off
+    float getSustainSample(double position) const noexcept;
+    float getReleaseSample(double position) const noexcept;
+
+    int getReleaseLength() const noexcept { return (int) release.size() - 1; }
+};
+
+
+//The frozen notes of one set of parameters: every noteStep semitones between lowestNote and highestNote,
+//the notes in between play the nearest one pitch-shifted.
+//A set can be handed to the audio thread before all its notes are rendered: each is read once it is ready.
+//Memory budget: at most maxSustainSeconds + loopSeconds + maxReleaseSeconds = 4.5 s of 16-bit samples per note,
+//430 KB at 48 kHz, so 13 MB per set with the default noteStep of 3 (30 notes) and 38 MB with noteStep 1 (88 notes).
+//The notes only take as long as their envelopes: a 0.5 s release keeps about 0.5 s of tail
+struct FrozenNoteSet
+{
+    static constexpr int lowestNote = 21; //A0
+    static constexpr int highestNote = 108; //C8
+
+    //Longest attack + decay kept before the loop, and longest release tail
+    static constexpr double maxSustainSeconds = 2.0;
+    static constexpr double maxReleaseSeconds = 2.0;
+    static constexpr double loopSeconds = 0.5;
+    static constexpr double loopCrossfadeSeconds = 0.05;
+
+    //From the sustain into the release tail at the note off
+    static constexpr double releaseCrossfadeSeconds = 0.01;
+
+    //From the note of the previous set (or the nearest note rendered) to the note of this one
+    static constexpr double crossfadeSeconds = 0.1;
+
+    FreezeSettings settings;
+    double sampleRate = 0.0;
+    int noteStep = 1;
+
+    std::vector<FrozenNote> notes;
+
+    //Allocates the notes (still to be rendered)
+    void prepare(const FreezeSettings& newSettings, double newSampleRate, int newNoteStep);
+
+    //Index of the note midiNote plays
+    int getIndex(int midiNote) const noexcept;
+
+    //Rendering threads: the note is ready to be read
+    void setReady(int index) noexcept;
+
+    //Audio thread: the note midiNote plays, nullptr until it is rendered
+    const FrozenNote* getNote(int midiNote) const noexcept;
+
+    //Audio thread: the rendered note nearest to midiNote, nullptr if none is yet
+    const FrozenNote* getNearestNote(int midiNote) const noexcept;
+
+    bool isComplete() const noexcept { return numReady.load() == (int) notes.size(); }
+
+    //Playback rate that shifts the note to midiNote
+    static double getPlaybackRate(const FrozenNote& note, int midiNote) noexcept;
+
+
+private:
+
+    std::unique_ptr<std::atomic<bool>[]> ready;
+    std::atomic<int> numReady{ 0 };
+};
+
+
+//Per-voice playback of frozen notes: one or two reads per sample, whatever the number of partials.
+//Until its note is rendered in the current set, a note plays from the previous set (or the nearest note
+//rendered), then crossfades to it
+class FrozenNotePlayer
+{
+public:
+
+    void start(int newMidiNote) noexcept;
+    void release() noexcept;
+    void stop() noexcept { playing = false; }
+
+    bool isPlaying() const noexcept { return playing; }
+
+    //Write numSamples samples of the sets of the snapshot.
+    //False once the release tail is over, or if there is nothing to play any more
+    bool render(const SynthParameterSnapshot& parameters, float* output, int numSamples) noexcept;
+
+
+private:
+
+    float getSample(const FrozenNote& note, double rate, double sampleRate) const noexcept;
+
+    int midiNote = 0;
+    bool playing = false;
+    bool released = false;
+
+    const FrozenNoteSet* set = nullptr; //current set of the last block
+    float weight = 1.0f; //of the note of the current set against the previous one
+
+    double elapsed = 0.0; //samples since the note on
+    double releaseElapsed = 0.0; //samples since the note off
+};
+
+
+//Renders the frozen notes of the requested parameters in the background, one job per note on a pool of
+//threads, and hands the sets to the audio thread.
+//The notes around the last ones played are rendered first: the set is handed over once they are ready,
+//and the others follow from the nearest. The audio thread holds the previous set until the new one is complete
+//(and for one crossfade after), so the notes crossfade from it as they are rendered.
+//A request arriving before a set is handed over abandons it (a parameter moving continuously costs one set once
+//it stops); a set handed over is finished first.
+//Three slots, so at most 39 MB per instance at 48 kHz (114 MB with noteStep 1, see FrozenNoteSet): the builder
+//waits for the audio thread to swap in the set it published last when the other two are held.
+class FreezeBuilder : private BackgroundBuilder
+{
+public:
+
+    FreezeBuilder();
+    ~FreezeBuilder() override;
+
+    //Audio thread, once per block: the sets for this block (current is nullptr until the first one is ready)
+    struct FrozenNotes
+    {
+        const FrozenNoteSet* current = nullptr;
+        const FrozenNoteSet* fadingOut = nullptr;
+    };
+
+    //Drops the sets of the previous rate (prepareToPlay)
+    void prepare(double sampleRate);
+
+    //Audio thread: a note started, the next sets render the notes around the last ones played first
+    void notePlayed(int midiNote) noexcept;
+
+    //Audio thread: ask for the notes of these settings (does nothing if they did not change)
+    void requestSettings(const FreezeSettings& settings, int noteStep) noexcept;
+
+    FrozenNotes update(int numSamples) noexcept;
+
+
+private:
+
+    struct Request
+    {
+        FreezeSettings settings;
+        int noteStep = 1;
+
+        //Range of the last notes played (empty if none was: the set is handed over complete)
+        int lowestPlayed = 0;
+        int highestPlayed = -1;
+    };
+
+    void build() override;
+
+    //Renders the notes of the slot on the pool and publishes it once those around the notes played are ready
+    void render(FrozenNoteSet& set, const Request& request);
+
+    SlotHandover<FrozenNoteSet, 3> slots;
+
+    Mailbox<Request> requests; //audio thread to builder
+
+    Request lastRequest; //only used by the audio thread
+    bool hasRequested = false;
+
+    std::array<int, 8> recentNotes{}; //audio thread
+    int numRecentNotes = 0;
+    int nextRecentNote = 0;
+
+    int holdSamples = 0; //audio thread: left before the previous set is released
+    int crossfadeSamples = 0;
+
+    std::atomic<bool> abandon{ false };
+    std::atomic<int> notesLeft{ 0 };
+    std::atomic<int> firstNotesLeft{ 0 }; //of those rendered before the set is published
+
+    juce::ThreadPool pool; //last: its jobs write in the slots
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FreezeBuilder)
+};
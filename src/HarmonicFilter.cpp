@@ -0,0 +1,73 @@
+#include "HarmonicFilter.h"
+
+
+namespace
+{
+    //Harmonic numbers 1..24, aligned so the kernel can load them directly
+    struct HarmonicNumbers
+    {
+        HarmonicNumbers()
+        {
+            for (size_t k = 0; k < values.size(); ++k)
+                values[k] = static_cast<float>(k + 1);
+        }
+
+        alignas (32) std::array<float, HarmonicFilter::numHarmonics> values;
+    };
+
+    const HarmonicNumbers harmonicNumbers;
+}
+
+
+void HarmonicFilter::computeGains(float* destination, float fundamental, float cutoff, float q) noexcept
+{
+    //Same formula of lowpass(), for all the harmonics at once:
+    //r = freq / cutoff, gain = 1 / sqrt((1 - r^2)^2 + (r / q)^2)
+
+    const float ratio = fundamental / cutoff;
+    const float inverseQ = 1.0f / q;
+
+    alignas (alignment) std::array<float, numHarmonics> denominator;
+
+   #if JUCE_USE_SIMD
+    static_assert (numHarmonics % Vec::size() == 0, "Harmonics must fill whole SIMD registers");
+
+    const auto one = Vec::expand(1.0f);
+
+    for (size_t i = 0; i < (size_t) numHarmonics; i += Vec::size())
+    {
+        auto r = Vec::fromRawArray(harmonicNumbers.values.data() + i) * Vec::expand(ratio);
+        auto a = one - r * r;
+        auto b = r * Vec::expand(inverseQ);
+        (a * a + b * b).copyToRawArray(denominator.data() + i);
+    }
+   #else
+    for (size_t i = 0; i < (size_t) numHarmonics; ++i)
+    {
+        float r = harmonicNumbers.values[i] * ratio;
+        float a = 1.0f - r * r;
+        float b = r * inverseQ;
+        denominator[i] = a * a + b * b;
+    }
+   #endif
+
+    //JUCE's SIMD registers have no square root, this loop is left to the compiler
+    for (size_t i = 0; i < (size_t) numHarmonics; ++i)
+        destination[i] = 1.0f / std::sqrt(denominator[i]);
+}
+
+double HarmonicFilter::lowpass(double freq, double cutoff, double q)
+{
+
+    //The lowpass filter is implemented in the diff synth simply by multiplying the harmonics
+    //with a frequency response. This is done because IIR would be inefficient in the training process.
+    //While we could use IIR filters here instead, we try to replicate the exact behaviour for accuracy.
+
+    //Freq: the frequency of the harmonic
+    //Cutoff: the cutoff frequency
+    //q: the q factor
+
+    double r = freq / cutoff;
+    return 1 / std::sqrt(std::pow( (1 - std::pow(r, 2.0)), 2.0) + std::pow(r / q, 2.0));
+
+}
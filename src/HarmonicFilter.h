@@ -0,0 +1,33 @@
+#pragma once
+#include "OscillatorBank.h"
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+
+//Lowpass applied to the harmonics, as in the differentiable synth used for training:
+//every harmonic is multiplied by the magnitude response of the filter at its frequency.
+//The cutoff only moves at envelope rate, so the gains are computed at control rate
+//(every few samples) and the oscillator bank interpolates them linearly in between.
+class HarmonicFilter
+{
+public:
+
+    static constexpr int numHarmonics = OscillatorBank::numHarmonics;
+    static constexpr int defaultControlInterval = 32;
+
+    //Float kernel for the magnitude response at harmonics 1..numHarmonics of the fundamental
+    static void computeGains(float* destination, float fundamental, float cutoff, float q) noexcept;
+
+    //Double precision formula of the training synth, the reference for computeGains
+    static double lowpass(double freq, double cutoff, double q);
+
+
+private:
+
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<float>;
+    static constexpr size_t alignment = Vec::SIMDRegisterSize;
+   #else
+    static constexpr size_t alignment = 16;
+   #endif
+
+};
@@ -0,0 +1,76 @@
+#include "InferenceBackend.h"
+#include "TorchScriptBackend.h"
+
+#if defined(__linux__)
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/resource.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#elif defined(__APPLE__)
+ #include <pthread.h>
+ #include <pthread/qos.h>
+#elif defined(_WIN32)
+ #define NOMINMAX
+ #include <windows.h>
+#endif
+
+
+void InferenceBackend::OutputLayout::add(const std::string& name, int size)
+{
+    entries.push_back({ name, numValues, size });
+    numValues += size;
+}
+
+const InferenceBackend::OutputLayout::Entry* InferenceBackend::OutputLayout::find(const std::string& name) const
+{
+    for (const auto& entry : entries)
+    {
+        if (entry.name == name)
+            return &entry;
+    }
+
+    return nullptr;
+}
+
+std::unique_ptr<InferenceBackend> InferenceBackend::createForModel(const std::string&)
+{
+    //The only runtime so far: TorchScript files (.pt) in libtorch
+    return std::make_unique<TorchScriptBackend>();
+}
+
+void InferenceBackend::applyThreadPriority(const SchedulingPolicy& policy)
+{
+#if defined(__linux__)
+    if (policy.lowPriority)
+    {
+        //Only runs on cores nothing else wants. Nice is per thread on Linux
+        sched_param parameters{};
+        if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &parameters) != 0)
+            setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), 19);
+    }
+
+    if (policy.affinityMask != 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64; ++cpu)
+        {
+            if ((policy.affinityMask >> cpu) & 1)
+                CPU_SET(cpu, &cpus);
+        }
+
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#elif defined(__APPLE__)
+    //No affinity on macOS: the background QoS keeps the thread on the efficiency cores when there are some
+    if (policy.lowPriority)
+        pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0);
+#elif defined(_WIN32)
+    if (policy.lowPriority)
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+
+    if (policy.affinityMask != 0)
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) policy.affinityMask);
+#endif
+}
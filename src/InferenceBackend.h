@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+//A runtime for the parameter estimation network: mono audio in (at getSampleRate()), a flat array of the
+//estimated synth parameters out, normalised to [0, 1] and laid out as getOutputLayout() says.
+//The plugin and the tools only see this interface, so the runtime (libtorch for the TorchScript models,
+//or a lighter one) changes without touching them, and no runtime types (tensors, dicts) leak above it.
+class InferenceBackend
+{
+public:
+
+    //Arithmetic of the forward pass. int8 is up to the backend (e.g. only the linear layers), and may be
+    //ignored by a backend that has no quantised operators
+    enum class Precision { float32, int8 };
+
+    //How inference shares the CPU with the audio threads of the host.
+    //Runtimes size their thread pools to all the cores by default, and they compete with the audio callbacks
+    struct SchedulingPolicy
+    {
+        int intraOpThreads = 2; //threads of a single operation, 0 for the runtime default
+        int interOpThreads = 1; //threads running independent operations, 0 for the default. Set once per process
+
+        bool lowPriority = true; //Linux: SCHED_IDLE (nice 19 if refused), Windows: idle thread priority
+        std::uint64_t affinityMask = 0; //cores the inference threads may use, 0 for any
+
+        //Background-friendly mode: the forward pass pauses between operations
+        //once it has run for sliceMicroseconds, so it never holds a core for long
+        bool backgroundFriendly = false;
+        int sliceMicroseconds = 2000;
+        int pauseMicroseconds = 500;
+    };
+
+    //Where each output of the network is in the flat array, in the order the model returns them
+    struct OutputLayout
+    {
+        struct Entry
+        {
+            std::string name;
+            int offset = 0;
+            int size = 0; //e.g. 2 for the values of both operators
+        };
+
+        std::vector<Entry> entries;
+        int numValues = 0;
+
+        void add(const std::string& name, int size);
+
+        //nullptr if the model has no such output
+        const Entry* find(const std::string& name) const;
+    };
+
+    virtual ~InferenceBackend() = default;
+
+    //The backend able to run this model file (TorchScript for now)
+    static std::unique_ptr<InferenceBackend> createForModel(const std::string& modelPath);
+
+    //Load the model and get it ready for the first estimation (optimisation, warm-up).
+    //Throws std::exception if it cannot be loaded. Takes seconds: call it from a background thread
+    virtual void load(const std::string& modelPath, Precision precision) = 0;
+
+    virtual std::string getName() const = 0;
+
+    //What the last load() could not do (e.g. quantise the model), one line each, empty if nothing
+    virtual std::string getLoadWarnings() const { return {}; }
+
+    //The outputs of the loaded model
+    virtual const OutputLayout& getOutputLayout() const = 0;
+
+    //Rate and length of the clips the network was trained on. Other lengths run, with less reliable results
+    virtual double getSampleRate() const = 0;
+    virtual int getClipSamples() const = 0;
+
+    //Estimate the parameters of numClips clips of numSamples samples each, stored one after the other, in a single pass.
+    //Writes getOutputLayout().numValues values per clip. The policy is applied to the calling thread first.
+    //Throws std::exception if the model fails
+    virtual void estimate(const float* audio, int numClips, int numSamples, float* outputs, const SchedulingPolicy& policy) = 0;
+
+    //Priority and affinity of the calling thread (the thread counts belong to the backends).
+    //The threads a runtime starts afterwards from this thread inherit them
+    static void applyThreadPriority(const SchedulingPolicy& policy);
+};
@@ -0,0 +1,449 @@
+#include "InferenceWorker.h"
+#include <condition_variable>
+#include <deque>
+
+
+//The thread running the jobs of every instance in the process, in the order they were queued
+class InferenceWorker::SharedThread : public juce::Thread
+{
+public:
+
+    struct Job
+    {
+        enum class Type { loadModel, estimate };
+
+        Type type;
+        juce::File file;
+        InferenceWorker* client;
+    };
+
+    //Created by the first instance, destroyed with the last one
+    static std::shared_ptr<SharedThread> getInstance()
+    {
+        static std::mutex instanceLock;
+        static std::weak_ptr<SharedThread> instance;
+
+        std::lock_guard<std::mutex> scopedLock(instanceLock);
+
+        auto thread = instance.lock();
+        if (thread == nullptr)
+        {
+            thread = std::make_shared<SharedThread>();
+            thread->startThread();
+            instance = thread;
+        }
+
+        return thread;
+    }
+
+    SharedThread()
+        : juce::Thread("Parameter estimation")
+    {
+    }
+
+    ~SharedThread() override
+    {
+        //Loading a model and the forward pass cannot be interrupted: wait for them
+        stopThread(-1);
+    }
+
+    //A newer model load replaces one still queued, and runs before the files already queued
+    void add(const Job& job)
+    {
+        {
+            std::lock_guard<std::mutex> scopedLock(queueLock);
+
+            if (job.type == Job::Type::loadModel)
+            {
+                removeJobs(*job.client, Job::Type::loadModel);
+                queue.insert(std::find_if(queue.begin(), queue.end(), [&](const Job& other) { return other.client == job.client; }), job);
+            }
+            else
+            {
+                queue.push_back(job);
+            }
+        }
+
+        notify();
+    }
+
+    //Drop the queued files of this client, and stop its estimation at the next step
+    void cancel(InferenceWorker& client)
+    {
+        std::lock_guard<std::mutex> scopedLock(queueLock);
+
+        removeJobs(client, Job::Type::estimate);
+
+        if (currentClient == &client)
+            cancelRequested = true;
+    }
+
+    //Drop all the jobs of this client, and wait until its current job (if any) returns
+    void remove(InferenceWorker& client)
+    {
+        std::unique_lock<std::mutex> scopedLock(queueLock);
+
+        queue.erase(std::remove_if(queue.begin(), queue.end(), [&](const Job& job) { return job.client == &client; }),
+                    queue.end());
+
+        if (currentClient == &client)
+            cancelRequested = true;
+
+        jobFinished.wait(scopedLock, [&] { return currentClient != &client; });
+    }
+
+    bool shouldStop() const noexcept { return threadShouldExit() || cancelRequested.load(); }
+
+    void run() override
+    {
+        //Before the runtime starts its pools from this thread: they inherit the priority
+        InferenceBackend::applyThreadPriority(InferenceBackend::SchedulingPolicy());
+
+        while (!threadShouldExit())
+        {
+            Job job{ Job::Type::estimate, {}, nullptr };
+
+            {
+                std::lock_guard<std::mutex> scopedLock(queueLock);
+
+                if (!queue.empty())
+                {
+                    job = queue.front();
+                    queue.pop_front();
+
+                    //Set with the lock held: a cancel() after this point stops this job
+                    currentClient = job.client;
+                    cancelRequested = false;
+                }
+            }
+
+            if (job.client == nullptr)
+            {
+                wait(-1);
+                continue;
+            }
+
+            if (job.type == Job::Type::loadModel)
+                job.client->runModelJob(job.file);
+            else
+                job.client->runJob(job.file);
+
+            {
+                std::lock_guard<std::mutex> scopedLock(queueLock);
+                currentClient = nullptr;
+            }
+
+            jobFinished.notify_all();
+        }
+    }
+
+
+private:
+
+    void removeJobs(InferenceWorker& client, Job::Type type)
+    {
+        queue.erase(std::remove_if(queue.begin(), queue.end(), [&](const Job& job) { return job.client == &client && job.type == type; }),
+                    queue.end());
+    }
+
+    std::mutex queueLock;
+    std::condition_variable jobFinished;
+    std::deque<Job> queue;
+
+    InferenceWorker* currentClient = nullptr;
+    std::atomic<bool> cancelRequested{ false };
+
+};
+
+
+InferenceWorker::InferenceWorker(juce::AudioProcessorValueTreeState& apvts, juce::ValueTree propertyRoot)
+    : sharedThread(SharedThread::getInstance()), apvts(apvts), propertyRoot(propertyRoot)
+{
+    formatManager.registerBasicFormats();
+
+    //Also clears the state saved with the plugin
+    triggerAsyncUpdate();
+}
+
+InferenceWorker::~InferenceWorker()
+{
+    sharedThread->remove(*this);
+
+    cancelPendingUpdate();
+}
+
+bool InferenceWorker::shouldStop() const noexcept
+{
+    return sharedThread->shouldStop();
+}
+
+InferenceBackend::Precision InferenceWorker::getRequestedPrecision() const noexcept
+{
+    return quantised.load() ? InferenceBackend::Precision::int8 : InferenceBackend::Precision::float32;
+}
+
+juce::File InferenceWorker::findModelFile(const juce::String& statePath)
+{
+    if (juce::File::isAbsolutePath(statePath) && juce::File(statePath).existsAsFile())
+        return juce::File(statePath);
+
+    const juce::String environmentPath = juce::SystemStats::getEnvironmentVariable(modelPathVariable, {});
+    if (juce::File::isAbsolutePath(environmentPath) && juce::File(environmentPath).existsAsFile())
+        return juce::File(environmentPath);
+
+    //For a plugin this is the plugin binary, e.g. Contents/x86_64-win/plugin.vst3 or Contents/MacOS/plugin
+    const juce::File binary = juce::File::getSpecialLocation(juce::File::currentExecutableFile);
+
+    for (auto bundled : { binary.getSiblingFile("traced_model.pt"),
+                          binary.getParentDirectory().getSiblingFile("Resources").getChildFile("traced_model.pt") })
+    {
+        if (bundled.existsAsFile())
+            return bundled;
+    }
+
+    return {};
+}
+
+void InferenceWorker::loadModel(const juce::File& newModelFile)
+{
+    modelFile = newModelFile;
+
+    //Before the files already queued: they are estimated with the new model
+    sharedThread->add({ SharedThread::Job::Type::loadModel, newModelFile, this });
+}
+
+void InferenceWorker::submit(const juce::File& audioFile)
+{
+    sharedThread->add({ SharedThread::Job::Type::estimate, audioFile, this });
+}
+
+void InferenceWorker::cancel()
+{
+    sharedThread->cancel(*this);
+}
+
+void InferenceWorker::runModelJob(const juce::File& newModelFile)
+{
+    {
+        const juce::ScopedLock lock(messageLock);
+        modelName = newModelFile.getFileName();
+        mismatchReport.clear();
+    }
+
+    //Released first: the weights are not held twice while the next model loads
+    model.reset();
+
+    if (!newModelFile.existsAsFile())
+    {
+        fail("No model found: choose a model file, or set " + juce::String(modelPathVariable));
+        return;
+    }
+
+    setState(State::loadingModel, 0.0f);
+
+    try
+    {
+        //Already loaded if another instance uses the same file
+        model = ModelRegistry::getInstance().acquire(newModelFile, getRequestedPrecision());
+    }
+    catch (const std::exception& e)
+    {
+        fail("Cannot load the model: " + juce::String(e.what()));
+        return;
+    }
+
+    //Once per model: the estimates are then copied to the parameters as they are
+    binding.build(model->backend->getOutputLayout(), apvts);
+
+    {
+        const juce::ScopedLock lock(messageLock);
+        mismatchReport = binding.getMismatchReport();
+    }
+
+    DBG(binding.getMismatchReport());
+
+    setState(State::ready, 0.0f);
+}
+
+void InferenceWorker::runJob(const juce::File& audioFile)
+{
+    //Quantisation switched since the model was loaded
+    if (model != nullptr && model->precision != getRequestedPrecision())
+    {
+        runModelJob(model->file);
+
+        if (model == nullptr)
+            return; //the error is reported
+    }
+
+    if (model == nullptr)
+    {
+        fail("No model loaded");
+        return;
+    }
+
+    setState(State::decoding, 0.0f);
+
+    InferenceBackend& backend = *model->backend;
+    const InferenceBackend::OutputLayout& layout = backend.getOutputLayout();
+
+    try
+    {
+        const bool decoded = loadAudio(audioFile, backend.getSampleRate());
+
+        if (shouldStop())
+        {
+            setState(State::cancelled, 0.0f);
+            return;
+        }
+
+        if (!decoded || audio.empty())
+        {
+            fail("Cannot read " + audioFile.getFileName());
+            return;
+        }
+
+        estimatedValues.resize((size_t) layout.numValues);
+
+        //The clip estimate_params runs on too: the records are shared
+        EstimationCache::fitToClip(audio, backend.getClipSamples());
+
+        //Estimated before with this model: no forward pass
+        auto& cache = EstimationCache::getInstance();
+        const juce::String cacheKey = EstimationCache::makeKey(audio.data(), audio.size(), model->checksum,
+                                                               EstimationCache::getModelVariant(model->precision));
+
+        EstimationCache::Record record;
+
+        if (!cache.load(cacheKey, record) || !EstimationCache::readRecord(record, layout, estimatedValues.data()))
+        {
+            setState(State::estimating, 0.3f);
+
+            //Thread count and background-friendly mode chosen by this instance
+            InferenceBackend::SchedulingPolicy policy;
+            policy.intraOpThreads = inferenceThreads.load();
+            policy.backgroundFriendly = backgroundFriendly.load();
+
+            backend.estimate(audio.data(), 1, (int) audio.size(), estimatedValues.data(), policy);
+
+            if (shouldStop())
+            {
+                setState(State::cancelled, 0.0f);
+                return;
+            }
+
+            if (!cache.store(cacheKey, EstimationCache::makeRecord(layout, estimatedValues.data())))
+                DBG("Cannot write the estimation cache in " + cache.getDirectory().getFullPathName());
+        }
+
+        auto& result = mailbox.getWriteBuffer();
+        result.numValues = binding.getNumValues();
+        result.targets = binding.getTargets();
+        std::copy(estimatedValues.begin(), estimatedValues.begin() + result.numValues, result.values.begin());
+
+        const juce::ScopedLock lock(messageLock);
+        estimatedDestinations = binding.getRouting(estimatedValues.data(), estimatedRouting);
+    }
+    catch (const std::exception& e) //what the backends throw
+    {
+        fail(e.what());
+        return;
+    }
+
+    mailbox.publish();
+
+    setState(State::done, 1.0f);
+}
+
+void InferenceWorker::setState(State newState, float newProgress)
+{
+    progress.store(newProgress);
+    state.store(newState);
+    triggerAsyncUpdate();
+}
+
+void InferenceWorker::fail(const juce::String& message)
+{
+    DBG("Parameter estimation failed: " + message);
+
+    {
+        const juce::ScopedLock lock(messageLock);
+        errorMessage = message;
+    }
+
+    setState(State::failed, 0.0f);
+}
+
+void InferenceWorker::handleAsyncUpdate()
+{
+    const State currentState = state.load();
+
+    juce::String status;
+    switch (currentState)
+    {
+        case State::noModel:      status = "No model loaded"; break;
+        case State::loadingModel: status = "Loading model..."; break;
+        case State::ready:        status = "Load an audio file to estimate the parameters"; break;
+        case State::decoding:     status = "Reading audio file..."; break;
+        case State::estimating:   status = "Estimating parameters..."; break;
+        case State::done:         status = "Parameters estimated"; break;
+        case State::cancelled:    status = "Estimation cancelled"; break;
+        case State::failed:       status = "Error"; break;
+    }
+
+    juce::String error, model, mismatch;
+    ModulationRouting routing;
+    int destinations = 0;
+    {
+        const juce::ScopedLock lock(messageLock);
+        model = modelName;
+        mismatch = mismatchReport;
+
+        routing = estimatedRouting;
+        destinations = std::exchange(estimatedDestinations, 0);
+
+        if (currentState == State::failed)
+            error = errorMessage;
+    }
+
+    //Looked up every time: loading the plugin state replaces the children of the root
+    auto estimation = propertyRoot.getOrCreateChildWithName("estimation", nullptr);
+    estimation.setProperty("progress", progress.load(), nullptr);
+    estimation.setProperty("status", status, nullptr);
+    estimation.setProperty("error", error, nullptr);
+    estimation.setProperty("busy", currentState == State::loadingModel || currentState == State::decoding || currentState == State::estimating, nullptr);
+    estimation.setProperty("model", model, nullptr);
+    estimation.setProperty("mismatch", mismatch, nullptr);
+
+    if (const EstimatedParameters* estimated = mailbox.read())
+        if (onParametersEstimated != nullptr)
+            onParametersEstimated(*estimated);
+
+    if (onRoutingEstimated != nullptr)
+        for (int i = 0; i < numModulationDestinations; ++i)
+            if (destinations & (1 << i))
+                onRoutingEstimated((ModulationDestination) i, routing.depths[(size_t) i]);
+}
+
+
+bool InferenceWorker::loadAudio(const juce::File& audioFile, double sampleRate)
+{
+    audio.clear();
+
+    std::unique_ptr<juce::AudioFormatReader> audioReader(formatManager.createReaderFor(audioFile));
+
+    if (audioReader == nullptr)
+        return false;
+
+    AudioFileLoader loader(*audioReader, sampleRate);
+
+    audio.resize((size_t) loader.getNumOutputSamples());
+
+    //Decoding is the first 30% of the job
+    return loader.read(audio.data(), [this](float fractionRead)
+    {
+        progress.store(0.3f * fractionRead);
+        triggerAsyncUpdate();
+        return !shouldStop();
+    });
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "ModelRegistry.h"
+#include "EstimationCache.h"
+#include "ParameterBinding.h"
+#include "Mailbox.h"
+#include "AudioFileLoader.h"
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+
+//Parameter values estimated by the network (normalised to [0, 1]), in the order of the model outputs,
+//with the parameter each one sets: ready to be applied without any lookup or allocation
+struct EstimatedParameters
+{
+    std::array<float, ParameterBinding::maxValues> values{};
+    ParameterBinding::Targets targets{}; //nullptr for the values that set nothing
+    int numValues = 0;
+};
+
+
+//Runs the parameter estimation (decode and resample the file, forward pass in the InferenceBackend of the model)
+//in the background, one job at a time from a queue of files.
+//The jobs of all the plugin instances of the process run on a single shared thread, and the instances
+//using the same model file share one copy of it (see ModelRegistry).
+//The model is loaded by the same thread, so the plugin is ready without stalling the host.
+//The results are kept in the EstimationCache: a clip estimated before with the same model skips the network.
+//The result is handed to the message thread through a single-slot mailbox, and to onParametersEstimated.
+//Progress, errors and cancellation are reported on the message thread as properties
+//of the "estimation" node of the magicState (progress, status, error, busy, model, and mismatch: the model
+//outputs and plugin parameters that do not match, see ParameterBinding).
+//The LFO routing estimated by the models that output one is handed to onRoutingEstimated.
+class InferenceWorker : private juce::AsyncUpdater
+{
+public:
+
+    InferenceWorker(juce::AudioProcessorValueTreeState& apvts, juce::ValueTree propertyRoot);
+    ~InferenceWorker() override;
+
+    //Environment variable with the path of the model, used when the plugin state has none
+    static constexpr const char* modelPathVariable = "NEURAL_SYNTH_MODEL";
+
+    //The model to load: the path saved in the plugin state if the file exists, then the environment
+    //variable, then traced_model.pt bundled next to the plugin binary (or in its Resources folder).
+    //Nonexistent file if none is found
+    static juce::File findModelFile(const juce::String& statePath);
+
+    //Message thread: queue the loading of a model (replaces a load still queued).
+    //Files queued afterwards are estimated with it
+    void loadModel(const juce::File& modelFile);
+
+    //Message thread: the model loaded last (or being loaded)
+    juce::File getModelFile() const { return modelFile; }
+
+    //Message thread: queue an audio file for estimation
+    void submit(const juce::File& audioFile);
+
+    //Message thread: drop the queued files and stop the current estimation at the next step
+    //(the forward pass itself cannot be interrupted, its result is discarded)
+    void cancel();
+
+    //Threads used by a forward pass, and whether it pauses regularly to leave the cores
+    //to the audio threads (see InferenceBackend::SchedulingPolicy). Used from the next estimation
+    void setInferenceThreads(int numThreads) noexcept { inferenceThreads.store(juce::jmax(1, numThreads)); }
+    void setBackgroundFriendly(bool shouldYield) noexcept { backgroundFriendly.store(shouldYield); }
+
+    //Run the model with int8 linear layers (see InferenceBackend::Precision): faster on slow machines, slightly
+    //different results. A change reloads the model before the next estimation
+    void setQuantised(bool shouldQuantise) noexcept { quantised.store(shouldQuantise); }
+
+    //Message thread: called with the parameters of every finished job
+    std::function<void(const EstimatedParameters&)> onParametersEstimated;
+
+    //Message thread: called with the depth of every LFO destination the model estimated
+    //(the routing is a session setting, not a parameter)
+    std::function<void(ModulationDestination, float depth)> onRoutingEstimated;
+
+
+private:
+
+    class SharedThread;
+
+    enum class State { noModel, loadingModel, ready, decoding, estimating, done, cancelled, failed };
+
+    //Shared thread
+    void runModelJob(const juce::File& modelFile);
+    void runJob(const juce::File& audioFile);
+
+    bool shouldStop() const noexcept;
+
+    InferenceBackend::Precision getRequestedPrecision() const noexcept;
+
+    void setState(State newState, float newProgress);
+    void fail(const juce::String& message);
+
+    //Publish the state in the magicState properties (message thread)
+    void handleAsyncUpdate() override;
+
+
+    //Decode the file at the rate of the model, mono, into audio.
+    //False if the file cannot be read or the job was cancelled
+    bool loadAudio(const juce::File& audioFile, double sampleRate);
+
+
+
+    std::shared_ptr<SharedThread> sharedThread;
+
+    //Only used by the shared thread
+    std::shared_ptr<SharedModel> model;
+    ParameterBinding binding; //of the model to this instance
+    std::vector<float> audio;
+    std::vector<float> estimatedValues;
+
+    juce::AudioProcessorValueTreeState& apvts;
+    juce::ValueTree propertyRoot;
+
+    juce::AudioFormatManager formatManager;
+
+    juce::File modelFile; //message thread
+
+    std::atomic<int> inferenceThreads{ InferenceBackend::SchedulingPolicy().intraOpThreads };
+    std::atomic<bool> backgroundFriendly{ false };
+    std::atomic<bool> quantised{ false };
+
+    std::atomic<State> state{ State::noModel };
+    std::atomic<float> progress{ 0.0f };
+
+    //Written by the worker, read by the message thread
+    juce::CriticalSection messageLock;
+    juce::String errorMessage;
+    juce::String modelName;
+    juce::String mismatchReport;
+    ModulationRouting estimatedRouting;
+    int estimatedDestinations = 0; //bits of ParameterBinding::getRouting, cleared once delivered
+
+    Mailbox<EstimatedParameters> mailbox;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(InferenceWorker)
+};
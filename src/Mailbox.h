@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+
+//Single-slot mailbox between one writer thread and one reader thread: the reader gets
+//the latest value written (older unread values are overwritten).
+//It is a triple buffer: the writer fills its own buffer and swaps it with the middle one,
+//the reader swaps the middle one with its own when something new was published.
+//Both sides are wait-free and nothing is allocated after construction.
+template <typename T>
+class Mailbox
+{
+public:
+
+    //Writer: fill the buffer returned by getWriteBuffer(), then publish() it
+    T& getWriteBuffer() noexcept { return buffers[(std::size_t) writeIndex]; }
+
+    void publish() noexcept
+    {
+        writeIndex = middle.exchange(writeIndex | newFlag) & indexMask;
+    }
+
+    //Reader: the latest published value, or nullptr if nothing was published since the last call.
+    //The value stays valid until the next call.
+    const T* read() noexcept
+    {
+        if ((middle.load() & newFlag) == 0)
+            return nullptr;
+
+        readIndex = middle.exchange(readIndex) & indexMask;
+        return &buffers[(std::size_t) readIndex];
+    }
+
+
+private:
+
+    static constexpr int indexMask = 3;
+    static constexpr int newFlag = 4;
+
+    std::array<T, 3> buffers;
+
+    int writeIndex = 0; //only used by the writer
+    int readIndex = 1; //only used by the reader
+    std::atomic<int> middle{ 2 };
+
+};
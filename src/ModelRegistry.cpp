@@ -0,0 +1,44 @@
+#include "ModelRegistry.h"
+#include <juce_cryptography/juce_cryptography.h>
+
+
+ModelRegistry& ModelRegistry::getInstance()
+{
+    static ModelRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<SharedModel> ModelRegistry::acquire(const juce::File& modelFile, InferenceBackend::Precision precision)
+{
+    const juce::String checksum = juce::SHA256(modelFile).toHexString();
+    const juce::String key = modelFile.getFullPathName() + "|" + checksum + "|" + juce::String((int) precision);
+
+    {
+        std::lock_guard<std::mutex> scopedLock(lock);
+
+        if (auto model = models[key].lock())
+            return model;
+    }
+
+    //Loaded without the lock: other models stay available meanwhile
+    auto model = std::make_shared<SharedModel>();
+    model->file = modelFile;
+    model->checksum = checksum;
+    model->precision = precision;
+    model->backend = InferenceBackend::createForModel(modelFile.getFullPathName().toStdString());
+    model->backend->load(modelFile.getFullPathName().toStdString(), precision);
+
+    std::lock_guard<std::mutex> scopedLock(lock);
+
+    //Loaded by another thread in the meantime: keep a single copy
+    if (auto existing = models[key].lock())
+        return existing;
+
+    models[key] = model;
+
+    //Forget the models nobody holds anymore
+    for (auto item = models.begin(); item != models.end();)
+        item = item->second.expired() ? models.erase(item) : std::next(item);
+
+    return model;
+}
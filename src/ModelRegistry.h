@@ -0,0 +1,41 @@
+#pragma once
+#include "InferenceBackend.h"
+#include <juce_core/juce_core.h>
+#include <map>
+#include <memory>
+#include <mutex>
+
+
+//A loaded (frozen and warmed up) model, shared by all the plugin instances using the same file
+struct SharedModel
+{
+    juce::File file;
+    juce::String checksum; //SHA-256 of the file
+    InferenceBackend::Precision precision = InferenceBackend::Precision::float32;
+    std::unique_ptr<InferenceBackend> backend;
+};
+
+
+//Process-wide table of the loaded models, keyed by path, checksum and precision: the plugin instances of a host
+//share one copy of the weights, loaded once. A model is freed when the last instance holding it releases it.
+//A file changed on disk has a new checksum, so it is loaded again.
+class ModelRegistry
+{
+public:
+
+    static ModelRegistry& getInstance();
+
+    //The model for this file, loaded if no instance holds it (which takes seconds: call from a background thread).
+    //Throws if the file cannot be loaded
+    std::shared_ptr<SharedModel> acquire(const juce::File& modelFile,
+                                         InferenceBackend::Precision precision = InferenceBackend::Precision::float32);
+
+
+private:
+
+    ModelRegistry() = default;
+
+    std::mutex lock;
+    std::map<juce::String, std::weak_ptr<SharedModel>> models;
+
+};
@@ -0,0 +1,73 @@
+#include "ModulationBus.h"
+#include <cmath>
+
+
+constexpr std::array<ModulationRouting::Names, numModulationDestinations> ModulationRouting::names;
+
+
+void ModulationBus::prepare(double newSampleRate, int maxBlockSize)
+{
+    sampleRate = newSampleRate;
+
+    //Longer blocks hold the last value (the host should not send them)
+    const size_t capacity = (size_t) (juce::jmax(1, maxBlockSize) / controlInterval + 2);
+    pitchRatios.assign(capacity, 1.0f);
+    cutoffRatios.assign(capacity, 1.0f);
+    amplitudeGains.assign(capacity, 1.0f);
+
+    reset();
+}
+
+void ModulationBus::reset() noexcept
+{
+    phase = 0.0;
+    numPoints = 1;
+    active.fill(false);
+}
+
+void ModulationBus::update(int numSamples, float rate, float level, const ModulationRouting& routing) noexcept
+{
+    if (pitchRatios.empty())
+        return;
+
+    for (size_t i = 0; i < active.size(); ++i)
+        active[i] = routing.depths[i] > 0.0f && level > 0.0f;
+
+    const double cyclesPerSample = rate * maxRateHz / sampleRate;
+    numPoints = juce::jmin((int) pitchRatios.size(), numSamples / controlInterval + 2);
+
+    if (active[(size_t) ModulationDestination::pitch] || active[(size_t) ModulationDestination::cutoff]
+        || active[(size_t) ModulationDestination::amplitude])
+    {
+        const float pitchDepth = routing.getDepth(ModulationDestination::pitch) * pitchRangeSemitones / 12.0f;
+        const float cutoffDepth = routing.getDepth(ModulationDestination::cutoff) * cutoffRangeOctaves;
+        const float amplitudeDepth = routing.getDepth(ModulationDestination::amplitude);
+
+        for (int point = 0; point < numPoints; ++point)
+        {
+            const double pointPhase = phase + cyclesPerSample * point * controlInterval;
+            const float lfo = level * (float) std::sin(juce::MathConstants<double>::twoPi * pointPhase);
+
+            pitchRatios[(size_t) point] = std::exp2(pitchDepth * lfo);
+            cutoffRatios[(size_t) point] = std::exp2(cutoffDepth * lfo);
+
+            //Tremolo: down to 1 - depth * level, never above the unmodulated level
+            amplitudeGains[(size_t) point] = 1.0f - amplitudeDepth * 0.5f * (level - lfo);
+        }
+    }
+
+    phase = std::fmod(phase + cyclesPerSample * numSamples, 1.0);
+}
+
+void ModulationBus::getAmplitudeGains(float* gains, int startSample, int numSamples) const noexcept
+{
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const int sample = startSample + i;
+        const size_t point = getPoint(sample);
+        const size_t next = juce::jmin(point + 1, (size_t) numPoints - 1);
+        const float position = (float) (sample - (int) point * controlInterval) / (float) controlInterval;
+
+        gains[i] = amplitudeGains[point] + juce::jmin(1.0f, position) * (amplitudeGains[next] - amplitudeGains[point]);
+    }
+}
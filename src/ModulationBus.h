@@ -0,0 +1,88 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+#include <vector>
+
+
+enum class ModulationDestination
+{
+    pitch,
+    cutoff,
+    amplitude
+};
+
+constexpr int numModulationDestinations = 3;
+
+//How much the LFO moves each destination, in [0, 1] (0: not routed).
+//At full depth and LFO_LEVEL 1 the LFO swings over the whole range of the destination (ModulationBus)
+struct ModulationRouting
+{
+    std::array<float, numModulationDestinations> depths{};
+
+    float getDepth(ModulationDestination destination) const noexcept { return depths[(size_t) destination]; }
+
+    //Session setting holding the depth, and output of the model that sets it (when the model has one)
+    struct Names
+    {
+        const char* setting;
+        const char* output;
+    };
+
+    static constexpr std::array<Names, numModulationDestinations> names{ {
+        { "lfoToPitch", "LFO_PITCH" },
+        { "lfoToCutoff", "LFO_CUTOFF" },
+        { "lfoToAmplitude", "LFO_AMP" }
+    } };
+};
+
+
+//The LFO (LFO_RATE, LFO_LEVEL) computed once per block for all the voices, at control rate,
+//and turned into the values the voices use directly: a frequency ratio for the pitch, a ratio for the cutoff,
+//and a gain for the amplitude. A voice reads them (one multiply, or a bank frequency update when the pitch
+//moved) instead of running an oscillator of its own.
+class ModulationBus
+{
+public:
+
+    //Samples between two control points
+    static constexpr int controlInterval = 32;
+
+    static constexpr double maxRateHz = 10.0; //at LFO_RATE 1
+    static constexpr float pitchRangeSemitones = 1.0f; //+- at full depth
+    static constexpr float cutoffRangeOctaves = 1.0f;
+
+    //Allocates (prepareToPlay)
+    void prepare(double sampleRate, int maxBlockSize);
+
+    void reset() noexcept;
+
+    //Audio thread, before the voices render: LFO_RATE and LFO_LEVEL as stored, and the routing
+    void update(int numSamples, float rate, float level, const ModulationRouting& routing) noexcept;
+
+    bool isActive(ModulationDestination destination) const noexcept { return active[(size_t) destination]; }
+
+    //Ratios for the control interval holding this sample of the block
+    float getPitchRatio(int sample) const noexcept { return pitchRatios[getPoint(sample)]; }
+    float getCutoffRatio(int sample) const noexcept { return cutoffRatios[getPoint(sample)]; }
+
+    //Gains of numSamples samples of the block from startSample, ramped between the control points
+    void getAmplitudeGains(float* gains, int startSample, int numSamples) const noexcept;
+
+
+private:
+
+    size_t getPoint(int sample) const noexcept { return (size_t) juce::jlimit(0, numPoints - 1, sample / controlInterval); }
+
+    double sampleRate = 44100.0;
+    double phase = 0.0; //cycles
+
+    //Values at every control point of the block (sample k * controlInterval), and one past the end
+    std::vector<float> pitchRatios;
+    std::vector<float> cutoffRatios;
+    std::vector<float> amplitudeGains;
+    int numPoints = 1;
+
+    std::array<bool, numModulationDestinations> active{};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ModulationBus)
+};
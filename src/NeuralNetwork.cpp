@@ -2,35 +2,226 @@
 
 #include <torch/torch.h>
 #include <torch/script.h>
+#include <ATen/record_function.h>
 #include "NeuralNetwork.h"
+#include <torch/csrc/jit/passes/dead_code_elimination.h>
+#include <ATen/core/dispatch/Dispatcher.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+
+namespace
+{
+	//Background-friendly mode of the current thread
+	struct YieldState
+	{
+		std::chrono::steady_clock::time_point sliceStart;
+		std::chrono::microseconds slice{ 0 };
+		std::chrono::microseconds pause{ 0 };
+	};
+
+	thread_local YieldState yieldState;
+
+	//Called when an operation of the forward pass starts
+	std::unique_ptr<at::ObserverContext> yieldIfSliceUsed(const at::RecordFunction&)
+	{
+		if (std::chrono::steady_clock::now() - yieldState.sliceStart > yieldState.slice)
+		{
+			std::this_thread::sleep_for(yieldState.pause);
+			yieldState.sliceStart = std::chrono::steady_clock::now();
+		}
+
+		return nullptr;
+	}
+}
 
 NeuralNetwork::NeuralNetwork()
+{
+}
+
+void NeuralNetwork::load(const std::string& modelPath, Precision precision)
 {
 
 	//Use Torchscript to load neural network
 	//trained with python SSSSM-DDSP
 
+	loaded = false;
+	numQuantisedLayers = 0;
+	loadWarnings.clear();
+
+	// Deserialize the ScriptModule from a file using torch::jit::load().
+	torch::jit::script::Module loadedModule = torch::jit::load(modelPath);
+	loadedModule.eval();
+
+	{
+		c10::InferenceMode guard;
+
+		try {
+			//Fold the weights into the graph as constants, then fuse the operations (conv + batch norm...)
+			torch::jit::script::Module frozenModule = torch::jit::freeze(loadedModule);
+
+			//Before the optimisation, which rewrites the linear layers as matrix products
+			if (precision == Precision::int8)
+			{
+				try {
+					numQuantisedLayers = quantiseLinearLayers(frozenModule);
+				}
+				catch (const c10::Error& e) {
+					//e.g. libtorch built without the quantised operators: the layers left stay in float
+					loadWarnings += std::string("could not quantise the model: ") + e.what_without_backtrace() + "\n";
+				}
+			}
+
+			module = torch::jit::optimize_for_inference(frozenModule);
+		}
+		catch (const c10::Error& e) {
+			//Some graphs cannot be frozen: they still run, only slower
+			loadWarnings += std::string("could not optimise the model: ") + e.what_without_backtrace() + "\n";
+			module = loadedModule;
+		}
+	}
 
-	try {
-		// Deserialize the ScriptModule from a file using torch::jit::load().
-		module = torch::jit::load("C:/Users/Ricky/projects/music/fm_synth_libtorch/traced_ssssm/traced_model.pt");
+	warmUp();
 
+	loaded = true;
+}
 
+void NeuralNetwork::applySchedulingPolicy(const SchedulingPolicy& policy)
+{
+	if (policy.intraOpThreads > 0)
+		torch::set_num_threads(policy.intraOpThreads);
+
+	//libtorch throws if the inter-op pool is resized after it started
+	static std::once_flag interOpThreadsSet;
+	if (policy.interOpThreads > 0)
+	{
+		std::call_once(interOpThreadsSet, [&] {
+			try {
+				torch::set_num_interop_threads(policy.interOpThreads);
+			}
+			catch (const c10::Error&) {
+				//Already started by another forward pass: it keeps its size
+			}
+		});
 	}
-	catch (const c10::Error& e) {
-		std::cerr << "error loading the model\n";
-	}
 
+	InferenceBackend::applyThreadPriority(policy);
+}
+
+NeuralNetwork::BackgroundScope::BackgroundScope(const SchedulingPolicy& policy)
+{
+	if (!policy.backgroundFriendly)
+		return;
 
-	std::cout << "Loaded model\n";
+	yieldState.sliceStart = std::chrono::steady_clock::now();
+	yieldState.slice = std::chrono::microseconds(policy.sliceMicroseconds);
+	yieldState.pause = std::chrono::microseconds(policy.pauseMicroseconds);
 
+	callbackHandle = at::addThreadLocalCallback(at::RecordFunctionCallback(yieldIfSliceUsed)
+		.scopes({ at::RecordScope::FUNCTION }));
+}
+
+NeuralNetwork::BackgroundScope::~BackgroundScope()
+{
+	if (callbackHandle != 0)
+		at::removeCallback(callbackHandle);
+}
+
+void NeuralNetwork::warmUp()
+{
+	auto x = torch::Dict<std::string, torch::Tensor>();
+	x.insert("audio", torch::zeros({ 1, warmUpSamples }));
+	torch::jit::IValue input = torch::ivalue::from(x);
 
+	for (int i = 0; i < numWarmUpRuns; ++i)
+		exampleOutput = forward(input);
 }
 
 
+int NeuralNetwork::quantiseLinearLayers(torch::jit::script::Module& frozenModule)
+{
+	//fbgemm on x86, qnnpack on ARM
+	const auto& engines = at::globalContext().supportedQEngines();
+	for (auto engine : { at::QEngine::FBGEMM, at::QEngine::QNNPACK })
+	{
+		if (std::find(engines.begin(), engines.end(), engine) != engines.end())
+		{
+			at::globalContext().setQEngine(engine);
+			break;
+		}
+	}
+
+	const c10::OperatorHandle prepack = c10::Dispatcher::singleton().findSchemaOrThrow("quantized::linear_prepack", "");
+
+	//fbgemm computes with 7-bit activations to avoid overflowing its 16-bit accumulators
+	const bool reduceRange = at::globalContext().qEngine() == at::QEngine::FBGEMM;
+
+	std::shared_ptr<torch::jit::Graph> graph = frozenModule.get_method("forward").graph();
+
+	//The linear layers in the graph, including the ones inside loops and conditions
+	std::vector<torch::jit::Node*> linearNodes;
+	std::function<void(torch::jit::Block*)> findLinearNodes = [&](torch::jit::Block* block) {
+		for (torch::jit::Node* node : block->nodes())
+		{
+			if (node->kind() == torch::jit::aten::linear)
+				linearNodes.push_back(node);
+
+			for (torch::jit::Block* subBlock : node->blocks())
+				findLinearNodes(subBlock);
+		}
+	};
+	findLinearNodes(graph->block());
+
+	int numQuantised = 0;
+
+	for (torch::jit::Node* node : linearNodes)
+	{
+		//Freezing turned the weights into constants, unless they are computed in the graph
+		const c10::optional<torch::IValue> weight = torch::jit::toIValue(node->input(1));
+		const c10::optional<torch::IValue> bias = torch::jit::toIValue(node->input(2));
+
+		if (!weight || !bias || !weight->isTensor() || weight->toTensor().dim() != 2 || weight->toTensor().scalar_type() != torch::kFloat32)
+			continue;
+
+		//Symmetric per output channel: the range of every row is used in full
+		const torch::Tensor weights = weight->toTensor();
+		const torch::Tensor scales = (weights.abs().amax(1).clamp_min(1e-8) / 127.0).to(torch::kDouble);
+		const torch::Tensor zeroPoints = torch::zeros({ weights.size(0) }, torch::kLong);
+		const torch::Tensor quantisedWeights = torch::quantize_per_channel(weights, scales, zeroPoints, 0, torch::kQInt8);
+
+		torch::jit::Stack stack{ quantisedWeights, *bias };
+		prepack.callBoxed(&stack);
+
+		torch::jit::WithInsertPoint insertPoint(node);
+		torch::jit::Value* packedWeights = graph->insertConstant(stack.back());
+		torch::jit::Value* reduceRangeValue = graph->insertConstant(reduceRange);
+
+		torch::jit::Node* quantisedNode = graph->create(c10::Symbol::fromQualString("quantized::linear_dynamic"),
+			{ node->input(0), packedWeights, reduceRangeValue });
+		graph->insertNode(quantisedNode);
+		quantisedNode->output()->setType(node->output()->type());
+
+		node->output()->replaceAllUsesWith(quantisedNode->output());
+		node->destroy();
+
+		++numQuantised;
+	}
+
+	//The float weights are not used anymore
+	torch::jit::EliminateDeadCode(graph);
+
+	return numQuantised;
+}
+
 torch::Tensor NeuralNetwork::forward(const torch::Tensor& input)
 {
 
+	c10::InferenceMode guard;
+
 	std::vector<torch::jit::IValue> my_input;
 	my_input.push_back(input);
 
@@ -41,6 +232,7 @@ torch::Tensor NeuralNetwork::forward(const torch::Tensor& input)
 
 torch::jit::IValue NeuralNetwork::forward(torch::jit::IValue input)
 {
+	c10::InferenceMode guard;
 
 	std::vector<torch::jit::IValue> my_input;
 	my_input.push_back(input);
@@ -1,7 +1,9 @@
 #pragma once
 
 
+#include "InferenceBackend.h"
 #include <torch/torch.h>
+#include <cstdint>
 
 
 class NeuralNetwork : torch::nn::Module {
@@ -9,7 +11,57 @@ class NeuralNetwork : torch::nn::Module {
 
 
 public:
+	//Sample rate of the audio the network was trained on
+	static constexpr double sampleRate = 16000.0;
+
+	//Length of the clips the network was trained on (4 s)
+	static constexpr int clipSamples = 4 * (int) sampleRate;
+
 	NeuralNetwork();
+
+	//int8: the weights of the linear layers are quantised per output channel when the model is loaded,
+	//and their inputs are quantised on the fly (dynamic quantisation). The other layers stay in float.
+	//A model quantised beforehand (in Python) is loaded as it is with float32
+	using Precision = InferenceBackend::Precision;
+
+	//Load a TorchScript model, freeze it and optimise it for inference, then run it
+	//on a few seconds of silence so the first estimation does not pay for the JIT profiling.
+	//Throws (c10::Error) if the file cannot be loaded. Takes several seconds: call it from a background thread
+	void load(const std::string& modelPath, Precision precision = Precision::float32);
+
+	bool isLoaded() const { return loaded; }
+
+	//The linear layers running in int8 (0 in float32, or if the quantised operators are not available)
+	int getNumQuantisedLayers() const { return numQuantisedLayers; }
+
+	//What the last load() could not do (quantise or optimise the model), one line each: the tools print it,
+	//the plugin reports only the model status
+	const std::string& getLoadWarnings() const { return loadWarnings; }
+
+	//The output of the warm-up pass on silence: the keys and shapes of what the model returns
+	const torch::jit::IValue& getExampleOutput() const { return exampleOutput; }
+
+
+	using SchedulingPolicy = InferenceBackend::SchedulingPolicy;
+
+	//Apply the libtorch thread counts (process-wide) and the priority and affinity of the calling thread.
+	//Call it from the inference thread before its first forward pass: the pool threads libtorch starts
+	//afterwards inherit the priority and the affinity
+	static void applySchedulingPolicy(const SchedulingPolicy& policy);
+
+	//While it exists, the forward passes of the calling thread yield the CPU every sliceMicroseconds
+	//(checked when an operation starts), if the policy is background-friendly
+	class BackgroundScope
+	{
+	public:
+		explicit BackgroundScope(const SchedulingPolicy& policy);
+		~BackgroundScope();
+
+	private:
+		std::uint64_t callbackHandle = 0;
+	};
+
+
 	std::vector<float> forward(const std::vector<float>& inputs);
 	torch::Tensor forward(const torch::Tensor& input);
 	void addTrainingData(std::vector<float> inputs, std::vector<float> outputs);
@@ -32,7 +84,20 @@ private:
 	torch::nn::Softmax softmax{ nullptr };
 	std::unique_ptr<torch::optim::SGD> optimiser;
 
+	static constexpr int warmUpSamples = clipSamples;
+	static constexpr int numWarmUpRuns = 2; //the profiling executor optimises the graph on the second run
+
+	void warmUp();
+
+	//Replace the linear layers with constant weights of a frozen module by dynamically quantised ones.
+	//Returns how many were replaced
+	static int quantiseLinearLayers(torch::jit::script::Module& frozenModule);
+
 	torch::jit::script::Module module;
+	bool loaded = false;
+	int numQuantisedLayers = 0;
+	std::string loadWarnings;
+	torch::jit::IValue exampleOutput;
 
 
 
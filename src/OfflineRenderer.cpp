@@ -0,0 +1,289 @@
+#include "OfflineRenderer.h"
+#include "ParameterDefinitions.h"
+#include "ParameterBinding.h"
+#include "SynthVoice.h"
+#include "SynthSound.h"
+#include <cmath>
+
+
+//Only there to hold the parameters: the APVTS needs a processor
+class OfflineRenderer::HeadlessProcessor : public juce::AudioProcessor
+{
+public:
+
+    HeadlessProcessor(double sampleRate)
+        : apvts(*this, nullptr, "Parameters", createParameterLayout(static_cast<float>(sampleRate / 2)))
+    {
+    }
+
+    const juce::String getName() const override { return "OfflineRenderer"; }
+
+    void prepareToPlay(double, int) override {}
+    void releaseResources() override {}
+    void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override {}
+
+    juce::AudioProcessorEditor* createEditor() override { return nullptr; }
+    bool hasEditor() const override { return false; }
+
+    bool acceptsMidi() const override { return true; }
+    bool producesMidi() const override { return false; }
+    double getTailLengthSeconds() const override { return 0.0; }
+
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram(int) override {}
+    const juce::String getProgramName(int) override { return {}; }
+    void changeProgramName(int, const juce::String&) override {}
+
+    void getStateInformation(juce::MemoryBlock&) override {}
+    void setStateInformation(const void*, int) override {}
+
+    juce::AudioProcessorValueTreeState apvts;
+};
+
+
+namespace
+{
+    //After the voices end, the chorus delay and the reverb response still ring
+    constexpr double effectsTailSeconds = 0.1;
+
+    //The destination set by a routing output of the model (e.g. LFO_PITCH), -1 for the other names
+    int getRoutingDestination(const juce::String& name)
+    {
+        for (size_t i = 0; i < ModulationRouting::names.size(); ++i)
+            if (name == ModulationRouting::names[i].output)
+                return (int) i;
+
+        return -1;
+    }
+}
+
+
+OfflineRenderer::OfflineRenderer(const Options& newOptions)
+    : options(newOptions),
+      processor(std::make_unique<HeadlessProcessor>(newOptions.sampleRate)),
+      synthParameters(std::make_unique<SynthParameterCache>(processor->apvts))
+{
+    synth.addSound(new SynthSound());
+
+    for (int i = 0; i < options.numVoices; ++i)
+    {
+        auto* voice = new SynthVoice(&synthParameters->getSnapshot());
+        voice->prepareToPlay(options.sampleRate, options.blockSize, 2);
+        synth.addVoice(voice);
+    }
+
+    synth.setCurrentPlaybackSampleRate(options.sampleRate);
+
+    modulationBus.prepare(options.sampleRate, options.blockSize);
+    chorus.prepare(options.sampleRate, 2);
+    block.setSize(2, options.blockSize);
+
+    //The level of detail of the plugin by default
+    synthParameters->setCullingThreshold(juce::Decibels::decibelsToGain(-100.0f));
+}
+
+OfflineRenderer::~OfflineRenderer() = default;
+
+juce::Result OfflineRenderer::setParameters(const juce::var& json)
+{
+    auto* object = json.getDynamicObject();
+    if (object == nullptr)
+        return juce::Result::fail("the parameters are not a JSON object");
+
+    //Notifying: the raw values the cache reads are only updated by the APVTS listener (there is no host)
+    for (auto* parameter : processor->getParameters())
+        parameter->setValueNotifyingHost(parameter->getDefaultValue());
+
+    routing = {};
+
+    const auto& properties = object->getProperties();
+    const bool estimated = properties.size() > 0 && properties.getValueAt(0).isArray();
+
+    if (estimated)
+    {
+        //The outputs of the model in the order of the file, as the network returns them
+        InferenceBackend::OutputLayout layout;
+        std::vector<float> values;
+
+        for (const auto& property : properties)
+        {
+            const auto* list = property.value.getArray();
+            if (list == nullptr)
+                return juce::Result::fail("output " + property.name.toString() + " is not a list of values");
+
+            InferenceBackend::OutputLayout::Entry entry;
+            entry.name = property.name.toString().toStdString();
+            entry.offset = layout.numValues;
+            entry.size = list->size();
+            layout.entries.push_back(entry);
+            layout.numValues += entry.size;
+
+            for (const auto& value : *list)
+                values.push_back(static_cast<float>(value));
+        }
+
+        ParameterBinding binding;
+        binding.build(layout, processor->apvts);
+
+        const auto& targets = binding.getTargets();
+        for (int i = 0; i < binding.getNumValues(); ++i)
+            if (targets[(size_t) i] != nullptr)
+                targets[(size_t) i]->setValueNotifyingHost(juce::jlimit(0.0f, 1.0f, values[(size_t) i]));
+
+        binding.getRouting(values.data(), routing);
+
+        const juce::String mismatch = binding.getMismatchReport();
+        if (mismatch.isNotEmpty())
+            DBG(mismatch);
+    }
+    else
+    {
+        for (const auto& property : properties)
+        {
+            const juce::String name = property.name.toString();
+            const float value = static_cast<float>(property.value);
+
+            const int destination = getRoutingDestination(name);
+            if (destination >= 0)
+            {
+                routing.depths[(size_t) destination] = juce::jlimit(0.0f, 1.0f, value);
+                continue;
+            }
+
+            auto* parameter = processor->apvts.getParameter(name);
+            if (parameter == nullptr)
+                return juce::Result::fail("unknown parameter " + name);
+
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+        }
+    }
+
+    return juce::Result::ok();
+}
+
+void OfflineRenderer::reset()
+{
+    synth.allNotesOff(0, false);
+
+    //The ramps start at the values of the parameters
+    synthParameters->prepare(options.sampleRate);
+    const SynthParameterSnapshot& parameters = synthParameters->update(options.blockSize);
+
+    for (int i = 0; i < synth.getNumVoices(); ++i)
+    {
+        if (auto* voice = dynamic_cast<SynthVoice*>(synth.getVoice(i)))
+        {
+            voice->updateADSRA1(parameters.adsr1.attack, parameters.adsr1.decay, parameters.adsr1.sustain, parameters.adsr1.release);
+            voice->updateADSRA2(parameters.adsr2.attack, parameters.adsr2.decay, parameters.adsr2.sustain, parameters.adsr2.release);
+            voice->updateADSRc(parameters.adsrC.attack, parameters.adsrC.decay, parameters.adsrC.sustain, parameters.adsrC.release);
+        }
+    }
+
+    modulationBus.reset();
+    chorus.reset();
+
+    //The response is built in the background: wait for it, so every render is the same
+    reverb.prepare(options.sampleRate, 2);
+    reverb.setParameters(parameters.revGain, parameters.revDecay);
+
+    if (!reverb.waitForResponse(5000))
+        DBG("The reverb response is not ready, the render starts without it");
+}
+
+juce::int64 OfflineRenderer::render(const juce::MidiMessageSequence& sequence, juce::AudioFormatWriter& writer)
+{
+    reset();
+
+    const auto toSamples = [&](double seconds) { return (juce::int64) std::llround(seconds * options.sampleRate); };
+
+    const juce::int64 endOfEvents = sequence.getNumEvents() > 0 ? toSamples(sequence.getEndTime()) : 0;
+    const juce::int64 maxLength = endOfEvents + toSamples(options.maxTailSeconds);
+    const juce::int64 effectsTail = toSamples(effectsTailSeconds);
+
+    juce::MidiBuffer midi;
+    int nextEvent = 0;
+
+    juce::int64 position = 0;
+    juce::int64 silentSince = -1;
+
+    while (position < maxLength && (silentSince < 0 || position - silentSince < effectsTail))
+    {
+        const int numSamples = (int) juce::jmin((juce::int64) options.blockSize, maxLength - position);
+
+        //The events of this block, at their sample in the block
+        midi.clear();
+        for (; nextEvent < sequence.getNumEvents(); ++nextEvent)
+        {
+            const auto& message = sequence.getEventPointer(nextEvent)->message;
+            const juce::int64 sample = toSamples(message.getTimeStamp());
+
+            if (sample >= position + numSamples)
+                break;
+
+            midi.addEvent(message, (int) juce::jmax((juce::int64) 0, sample - position));
+        }
+
+        const SynthParameterSnapshot& parameters = synthParameters->update(numSamples);
+
+        modulationBus.update(numSamples, parameters.lfoRate, parameters.lfoLevel, routing);
+        synthParameters->setModulation(&modulationBus);
+
+        block.clear();
+        synth.renderNextBlock(block, midi, 0, numSamples);
+
+        chorus.process(block, numSamples, parameters.mdDelay, parameters.mdDepth, parameters.mdMix);
+        reverb.process(block, numSamples);
+
+        writer.writeFromAudioSampleBuffer(block, 0, numSamples);
+        position += numSamples;
+
+        //Once all the events are played and every voice has ended, only the effects are left
+        bool voicesActive = false;
+        for (int i = 0; i < synth.getNumVoices() && !voicesActive; ++i)
+            voicesActive = synth.getVoice(i)->isVoiceActive();
+
+        if (position < endOfEvents || voicesActive)
+            silentSince = -1;
+        else if (silentSince < 0)
+            silentSince = position;
+    }
+
+    return position;
+}
+
+juce::Result OfflineRenderer::render(const juce::File& midiFile, const juce::File& wavFile)
+{
+    juce::FileInputStream input(midiFile);
+    if (!input.openedOk())
+        return juce::Result::fail("cannot read " + midiFile.getFullPathName());
+
+    juce::MidiFile file;
+    if (!file.readFrom(input))
+        return juce::Result::fail(midiFile.getFullPathName() + " is not a MIDI file");
+
+    file.convertTimestampTicksToSeconds();
+
+    juce::MidiMessageSequence sequence;
+    for (int track = 0; track < file.getNumTracks(); ++track)
+        sequence.addSequence(*file.getTrack(track), 0.0);
+
+    sequence.updateMatchedPairs();
+
+    wavFile.deleteFile();
+    std::unique_ptr<juce::FileOutputStream> output(wavFile.createOutputStream());
+    if (output == nullptr)
+        return juce::Result::fail("cannot write " + wavFile.getFullPathName());
+
+    juce::WavAudioFormat format;
+    std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(output.get(), options.sampleRate, 2,
+                                                                           options.bitsPerSample, {}, 0));
+    if (writer == nullptr)
+        return juce::Result::fail("cannot write a WAV file at " + juce::String(options.sampleRate) + " Hz, "
+                                  + juce::String(options.bitsPerSample) + " bits");
+
+    output.release(); //owned by the writer
+
+    render(sequence, *writer);
+    return juce::Result::ok();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "SynthParameters.h"
+#include "ModulationBus.h"
+#include "BusChorus.h"
+#include "BusReverb.h"
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <memory>
+
+
+//Renders MIDI files with the synth of the plugin without a host nor a GUI: the same voices, the parameter
+//layout of createParameterLayout() and the chorus and reverb of FMPluginProcessor, as fast as the CPU goes.
+//A renderer renders one file at a time: use one per thread to render several files in parallel.
+//Create the renderers on the message thread (the parameters are an AudioProcessorValueTreeState).
+class OfflineRenderer
+{
+public:
+
+    struct Options
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        int numVoices = 32;
+        int bitsPerSample = 24;
+
+        //Longest release after the last MIDI event
+        double maxTailSeconds = 10.0;
+    };
+
+    explicit OfflineRenderer(const Options& options);
+    ~OfflineRenderer();
+
+    //The parameters of the next renders, from a JSON object: either parameter ID -> value in the range of the
+    //parameter, or the output of the estimator (output name -> list of normalised values, as estimate_params
+    //writes it, bound like the plugin does with ParameterBinding). The LFO routing outputs (LFO_PITCH...) set
+    //the routing in both forms. The parameters it does not set have their default values
+    juce::Result setParameters(const juce::var& json);
+
+    //Render a MIDI file, all the tracks together, to a stereo WAV file
+    juce::Result render(const juce::File& midiFile, const juce::File& wavFile);
+
+    //Render a sequence (timestamps in seconds) to the writer, until the voices and the effects are silent.
+    //Every render starts from silence, and the reverb fades in over its first crossfade as in the plugin.
+    //Returns the number of samples written
+    juce::int64 render(const juce::MidiMessageSequence& sequence, juce::AudioFormatWriter& writer);
+
+
+private:
+
+    class HeadlessProcessor;
+
+    //The voices, modulation and effects back to the start, with the current parameters
+    void reset();
+
+    Options options;
+
+    std::unique_ptr<HeadlessProcessor> processor;
+    std::unique_ptr<SynthParameterCache> synthParameters;
+
+    juce::Synthesiser synth;
+
+    ModulationRouting routing;
+    ModulationBus modulationBus;
+
+    BusChorus chorus;
+    BusReverb reverb;
+
+    juce::AudioBuffer<float> block;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OfflineRenderer)
+};
@@ -0,0 +1,306 @@
+#include "OscillatorBank.h"
+
+
+OscillatorBank::OscillatorBank()
+{
+    sinDelta.fill(0.0f);
+    cosDelta.fill(1.0f);
+    amplitudes.fill(0.0f);
+    targetAmplitudes.fill(0.0f);
+    phaseDeltas.fill(0.0);
+
+    reset();
+}
+
+void OscillatorBank::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+
+    reset();
+}
+
+void OscillatorBank::reset()
+{
+    //Same starting phase of juce::dsp::Oscillator (which outputs sin(phase - pi))
+    sinState.fill(0.0f);
+    cosState.fill(-1.0f);
+
+    phases.fill(0.0);
+    samplesSincePhaseUpdate = 0;
+    groupActive.fill(true);
+
+    samplesSinceRenormalise = 0;
+}
+
+void OscillatorBank::setFrequency(int oscillator, float fundamental)
+{
+    jassert(oscillator >= 0 && oscillator < numOscillators);
+
+    for (int k = 1; k <= numHarmonics; ++k)
+    {
+        //Angle the phasor is rotated by at every sample
+        double delta = juce::MathConstants<double>::twoPi * k * fundamental / sampleRate;
+
+        auto index = (size_t) (oscillator * numHarmonics + k - 1);
+        sinDelta[index] = (float) std::sin(delta);
+        cosDelta[index] = (float) std::cos(delta);
+        phaseDeltas[index] = std::atan2((double) sinDelta[index], (double) cosDelta[index]);
+    }
+}
+
+float OscillatorBank::processSample() noexcept
+{
+    float output = 0.0f;
+
+    //Every partial is computed here
+    for (size_t group = 0; group < numGroups; ++group)
+    {
+        if (!groupActive[group])
+            resyncGroup(group);
+    }
+
+   #if JUCE_USE_SIMD
+    auto sum = Vec::expand(0.0f);
+
+    for (size_t i = 0; i < (size_t) numPartials; i += Vec::size())
+    {
+        auto s = Vec::fromRawArray(sinState.data() + i);
+        auto c = Vec::fromRawArray(cosState.data() + i);
+        auto ds = Vec::fromRawArray(sinDelta.data() + i);
+        auto dc = Vec::fromRawArray(cosDelta.data() + i);
+
+        sum += Vec::fromRawArray(amplitudes.data() + i) * s;
+
+        //Rotate the phasors by one sample
+        (s * dc + c * ds).copyToRawArray(sinState.data() + i);
+        (c * dc - s * ds).copyToRawArray(cosState.data() + i);
+    }
+
+    output = sum.sum();
+   #else
+    for (size_t i = 0; i < (size_t) numPartials; ++i)
+    {
+        float s = sinState[i];
+        float c = cosState[i];
+
+        output += amplitudes[i] * s;
+
+        sinState[i] = s * cosDelta[i] + c * sinDelta[i];
+        cosState[i] = c * cosDelta[i] - s * sinDelta[i];
+    }
+   #endif
+
+    ++samplesSincePhaseUpdate;
+
+    if (++samplesSinceRenormalise >= renormaliseInterval)
+        renormalise();
+
+    return output;
+}
+
+void OscillatorBank::render(float* outputOsc1, float* outputOsc2, int numSamples) noexcept
+{
+    updateActiveGroups();
+
+    renderOscillator(0, outputOsc1, numSamples);
+    renderOscillator(1, outputOsc2, numSamples);
+
+    amplitudes = targetAmplitudes;
+
+    samplesSincePhaseUpdate += numSamples;
+    updatePhases();
+
+    renormalise();
+}
+
+void OscillatorBank::renderOscillator(int oscillator, float* output, int numSamples) noexcept
+{
+    const size_t first = (size_t) (oscillator * numHarmonics);
+    const size_t last = first + (size_t) numHarmonics;
+
+    //Amplitude increment of each partial for one sample
+    alignas (alignment) std::array<float, numHarmonics> ampSteps;
+
+    bool anyActive = false;
+    for (size_t group = first / groupSize; group < last / groupSize; ++group)
+        anyActive = anyActive || groupActive[group];
+
+    if (!anyActive)
+    {
+        juce::FloatVectorOperations::clear(output, numSamples);
+        return;
+    }
+
+    for (size_t i = first; i < last; ++i)
+        ampSteps[i - first] = (targetAmplitudes[i] - amplitudes[i]) / static_cast<float>(numSamples);
+
+   #if JUCE_USE_SIMD
+    //The block is split in short slices. For each register of partials the phasor state
+    //stays in registers along the whole slice, and the products are accumulated per sample
+    //as vectors: the horizontal sum is done once per sample, not once per register
+    constexpr int sliceLength = 64;
+    static_assert (renormaliseInterval % sliceLength == 0, "Renormalisation must fall at the end of a slice");
+
+    Vec accumulators[sliceLength];
+
+    for (int sliceStart = 0; sliceStart < numSamples; sliceStart += sliceLength)
+    {
+        const int length = juce::jmin(sliceLength, numSamples - sliceStart);
+        const bool renormaliseAtEnd = ((sliceStart + length) % renormaliseInterval) == 0;
+
+        for (int n = 0; n < length; ++n)
+            accumulators[n] = Vec::expand(0.0f);
+
+        for (size_t i = first; i < last; i += Vec::size())
+        {
+            if (!groupActive[i / groupSize])
+                continue;
+
+            auto s = Vec::fromRawArray(sinState.data() + i);
+            auto c = Vec::fromRawArray(cosState.data() + i);
+            auto ds = Vec::fromRawArray(sinDelta.data() + i);
+            auto dc = Vec::fromRawArray(cosDelta.data() + i);
+            auto ampStep = Vec::fromRawArray(ampSteps.data() + i - first);
+            auto amp = Vec::fromRawArray(amplitudes.data() + i) + ampStep * Vec::expand(static_cast<float>(sliceStart));
+
+            for (int n = 0; n < length; ++n)
+            {
+                amp += ampStep;
+                accumulators[n] += amp * s;
+
+                auto rotatedSin = s * dc + c * ds;
+                c = c * dc - s * ds;
+                s = rotatedSin;
+            }
+
+            if (renormaliseAtEnd)
+            {
+                auto gain = Vec::expand(1.5f) - Vec::expand(0.5f) * (s * s + c * c);
+                s *= gain;
+                c *= gain;
+            }
+
+            s.copyToRawArray(sinState.data() + i);
+            c.copyToRawArray(cosState.data() + i);
+        }
+
+        for (int n = 0; n < length; ++n)
+            output[sliceStart + n] = accumulators[n].sum();
+    }
+   #else
+    juce::FloatVectorOperations::clear(output, numSamples);
+
+    for (size_t i = first; i < last; ++i)
+    {
+        if (!groupActive[i / groupSize])
+            continue;
+
+        float s = sinState[i];
+        float c = cosState[i];
+        float amp = amplitudes[i];
+
+        for (int n = 0; n < numSamples; ++n)
+        {
+            amp += ampSteps[i - first];
+            output[n] += amp * s;
+
+            float rotatedSin = s * cosDelta[i] + c * sinDelta[i];
+            c = c * cosDelta[i] - s * sinDelta[i];
+            s = rotatedSin;
+
+            if ((n + 1) % renormaliseInterval == 0)
+            {
+                float gain = 1.5f - 0.5f * (s * s + c * c);
+                s *= gain;
+                c *= gain;
+            }
+        }
+
+        sinState[i] = s;
+        cosState[i] = c;
+    }
+   #endif
+}
+
+void OscillatorBank::updateActiveGroups() noexcept
+{
+    for (size_t group = 0; group < numGroups; ++group)
+    {
+        bool audible = false;
+        for (size_t i = group * groupSize; i < (group + 1) * groupSize; ++i)
+            audible = audible || amplitudes[i] != 0.0f || targetAmplitudes[i] != 0.0f;
+
+        if (audible && !groupActive[group])
+            resyncGroup(group);
+
+        groupActive[group] = audible;
+    }
+}
+
+void OscillatorBank::resyncGroup(size_t group) noexcept
+{
+    updatePhases();
+
+    //The phasors start from phase - pi (see reset())
+    for (size_t i = group * groupSize; i < (group + 1) * groupSize; ++i)
+    {
+        sinState[i] = (float) -std::sin(phases[i]);
+        cosState[i] = (float) -std::cos(phases[i]);
+    }
+
+    groupActive[group] = true;
+}
+
+void OscillatorBank::updatePhases() noexcept
+{
+    for (size_t i = 0; i < (size_t) numPartials; ++i)
+        phases[i] = std::fmod(phases[i] + samplesSincePhaseUpdate * phaseDeltas[i], juce::MathConstants<double>::twoPi);
+
+    samplesSincePhaseUpdate = 0;
+}
+
+int OscillatorBank::getNumActiveGroups() const noexcept
+{
+    return (int) std::count(groupActive.begin(), groupActive.end(), true);
+}
+
+void OscillatorBank::renormalise() noexcept
+{
+    //One Newton step towards |phasor| = 1 (the error is always tiny, so this is enough)
+    for (size_t i = 0; i < (size_t) numPartials; ++i)
+    {
+        float gain = 1.5f - 0.5f * (sinState[i] * sinState[i] + cosState[i] * cosState[i]);
+        sinState[i] *= gain;
+        cosState[i] *= gain;
+    }
+
+    samplesSinceRenormalise = 0;
+}
+
+
+WaveformHarmonics::WaveformHarmonics()
+{
+    float sumSaw = 0.0f;
+    float sumSquare = 0.0f;
+
+    for (int k = 1; k <= OscillatorBank::numHarmonics; k++)
+    {
+        //Compute the harmonics amplitude
+        float sawAmp = (1.0f / k) * 2 / juce::MathConstants<float>::pi;
+        int odd = (k % 2 != 0); //Only odd harmonics for the square wave
+        float squareAmp = (1.0f / k) * 4 / juce::MathConstants<float>::pi * odd;
+
+        saw[(size_t) k - 1] = sawAmp;
+        square[(size_t) k - 1] = squareAmp;
+
+        sumSaw += sawAmp;
+        sumSquare += squareAmp;
+    }
+
+    //Normalize the amplitudes
+    for (float& value : saw)
+        value /= sumSaw;
+
+    for (float& value : square)
+        value /= sumSquare;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+
+//Additive oscillator bank holding the harmonic partials of both synths.
+//Phases, increments and amplitudes are stored as contiguous aligned arrays
+//(structure of arrays), so several partials are advanced by a single SIMD instruction
+//(SSE/NEON: 4 partials, AVX: 8 partials, as chosen by juce::dsp::SIMDRegister).
+//Each partial is a rotating phasor: no sine has to be evaluated inside the render loop.
+//
+//Registers of partials whose amplitudes are all zero (culled by the voice) are skipped by render().
+//Their phasors stop, and are set again from a double precision phase when they come back,
+//so the harmonics keep their phase relationship.
+class OscillatorBank
+{
+public:
+
+    static constexpr int numHarmonics = 24;
+    static constexpr int numOscillators = 2;
+    static constexpr int numPartials = numHarmonics * numOscillators;
+
+    OscillatorBank();
+
+    void prepare(double sampleRate);
+
+    //Move all the partials back to their initial phase
+    void reset();
+
+    //Set the fundamental frequency of one oscillator (0 or 1). Harmonic k runs at k * fundamental
+    void setFrequency(int oscillator, float fundamental);
+
+    //Amplitudes of the 24 harmonics of one oscillator, used by the next rendered samples
+    float* getAmplitudes(int oscillator) noexcept { return amplitudes.data() + oscillator * numHarmonics; }
+
+    //Amplitudes to be reached at the end of the next render() call
+    float* getTargetAmplitudes(int oscillator) noexcept { return targetAmplitudes.data() + oscillator * numHarmonics; }
+
+    //Use the target amplitudes straight away, without a ramp (e.g. when a note starts)
+    void jumpToTargetAmplitudes() noexcept { amplitudes = targetAmplitudes; }
+
+    //Compute one sample as the amplitude-weighted sum of all the partials of both oscillators
+    float processSample() noexcept;
+
+    //Render a block for each oscillator (the sums of their harmonics) while the amplitudes
+    //move linearly to the target amplitudes, reached on the last sample.
+    //The output buffers are overwritten.
+    void render(float* outputOsc1, float* outputOsc2, int numSamples) noexcept;
+
+    //Number of registers of partials computed by the last render() call (for statistics)
+    int getNumActiveGroups() const noexcept;
+
+
+private:
+
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<float>;
+    static constexpr size_t alignment = Vec::SIMDRegisterSize;
+    static constexpr size_t groupSize = Vec::size();
+    static_assert (numHarmonics % Vec::size() == 0, "Harmonics must fill whole SIMD registers");
+   #else
+    static constexpr size_t alignment = 16;
+    static constexpr size_t groupSize = 4;
+   #endif
+
+    static constexpr size_t numGroups = numPartials / groupSize;
+
+    //The phasor drifts slowly away from the unit circle because of rounding:
+    //we pull it back every renormaliseInterval samples
+    static constexpr int renormaliseInterval = 256;
+
+    void renormalise() noexcept;
+
+    void renderOscillator(int oscillator, float* output, int numSamples) noexcept;
+
+    //Skip the groups of silent partials, and set the phasors of the groups coming back
+    void updateActiveGroups() noexcept;
+    void resyncGroup(size_t group) noexcept;
+    void updatePhases() noexcept;
+
+    alignas (alignment) std::array<float, numPartials> sinState;
+    alignas (alignment) std::array<float, numPartials> cosState;
+    alignas (alignment) std::array<float, numPartials> sinDelta;
+    alignas (alignment) std::array<float, numPartials> cosDelta;
+    alignas (alignment) std::array<float, numPartials> amplitudes;
+    alignas (alignment) std::array<float, numPartials> targetAmplitudes;
+
+    std::array<bool, numGroups> groupActive;
+
+    //Phase of every partial in double precision, advanced once per block, to resync the skipped
+    //partials. The increment is the angle the float phasor really rotates by, so they do not drift apart.
+    std::array<double, numPartials> phases;
+    std::array<double, numPartials> phaseDeltas;
+    int samplesSincePhaseUpdate = 0;
+
+    double sampleRate = 44100.0;
+    int samplesSinceRenormalise = 0;
+
+};
+
+
+//Normalised amplitudes of the harmonics of the saw and square waves,
+//the two waveforms mixed by M_OSC_1 and M_OSC_2
+struct WaveformHarmonics
+{
+    WaveformHarmonics();
+
+    //Amplitude of harmonic k (starting from 1) for the given saw-square mix
+    float getAmplitude(int k, float mix) const noexcept { return (1 - mix) * saw[(size_t) k - 1] + mix * square[(size_t) k - 1]; }
+
+    std::array<float, OscillatorBank::numHarmonics> saw;
+    std::array<float, OscillatorBank::numHarmonics> square;
+};
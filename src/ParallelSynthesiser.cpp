@@ -0,0 +1,368 @@
+#include "ParallelSynthesiser.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+
+namespace
+{
+    //Spin-wait hint: leaves the core's resources to the other hardware thread while a worker finishes
+    inline void cpuPause() noexcept
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && (JUCE_GCC || JUCE_CLANG)
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+}
+
+
+class ParallelSynthesiser::Worker : public juce::Thread
+{
+public:
+
+    Worker(ParallelSynthesiser& owner, int index)
+        : juce::Thread("Voice renderer " + juce::String(index)), owner(owner)
+    {
+    }
+
+    ~Worker() override
+    {
+        stopThread(1000);
+    }
+
+    //Realtime, like the audio thread that waits for it: a preempted worker makes the block late
+    void start()
+    {
+       #if JUCE_MAJOR_VERSION >= 8
+        //Realtime scheduling can be refused (e.g. no rtprio limit on Linux)
+        if (!startRealtimeThread(juce::Thread::RealtimeOptions{}.withPriority(10)))
+            startThread(juce::Thread::Priority::highest);
+       #elif JUCE_MAJOR_VERSION == 7 && JUCE_BUILDNUMBER >= 3
+        startThread(juce::Thread::Priority::highest);
+       #else
+        startThread(10);
+       #endif
+    }
+
+    //Audio thread, after a job was published: only signal a worker that went to sleep
+    void wakeUp() noexcept
+    {
+        if (sleeping.load())
+            notify();
+    }
+
+    void run() override
+    {
+        juce::uint32 lastGeneration = getGeneration(owner.taskCounter.load());
+
+        while (!threadShouldExit())
+        {
+            const juce::uint32 generation = waitForJob(lastGeneration);
+
+            if (generation != lastGeneration)
+            {
+                lastGeneration = generation;
+                owner.renderTasks(generation);
+            }
+        }
+    }
+
+
+private:
+
+    //Spin for a while (the next block often comes soon), then sleep until woken up
+    juce::uint32 waitForJob(juce::uint32 lastGeneration) noexcept
+    {
+        for (int i = 0; i < spinCount; ++i)
+        {
+            const juce::uint32 generation = getGeneration(owner.taskCounter.load());
+            if (generation != lastGeneration)
+                return generation;
+
+            juce::Thread::yield();
+        }
+
+        //Checked again after setting the flag: a job published in between is not missed
+        sleeping.store(true);
+
+        juce::uint32 generation = getGeneration(owner.taskCounter.load());
+        if (generation == lastGeneration)
+        {
+            wait(100);
+            generation = getGeneration(owner.taskCounter.load());
+        }
+
+        sleeping.store(false);
+        return generation;
+    }
+
+    static constexpr int spinCount = 2000;
+
+    ParallelSynthesiser& owner;
+    std::atomic<bool> sleeping{ false };
+
+};
+
+
+ParallelSynthesiser::ParallelSynthesiser()
+{
+}
+
+ParallelSynthesiser::~ParallelSynthesiser()
+{
+    setNumWorkers(0);
+}
+
+void ParallelSynthesiser::setNumWorkers(int numWorkers)
+{
+    for (auto* worker : workers)
+        worker->signalThreadShouldExit();
+
+    workers.clear();
+
+    const int numCpus = juce::SystemStats::getNumCpus();
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        auto* worker = workers.add(new Worker(*this, i));
+
+        //One core each, leaving the first one to the audio thread (when there are enough)
+        if (numCpus > 1 && numCpus <= 32)
+            worker->setAffinityMask(1u << (juce::uint32) (1 + i % (numCpus - 1)));
+
+        worker->start();
+    }
+}
+
+int ParallelSynthesiser::getDefaultNumWorkers()
+{
+    return juce::jlimit(0, 7, juce::SystemStats::getNumPhysicalCpus() - 1);
+}
+
+void ParallelSynthesiser::prepare(int numChannels, int newMaximumBlockSize)
+{
+    numBufferChannels = numChannels;
+    maximumBlockSize = newMaximumBlockSize;
+
+    voiceBuffers.clear();
+    voiceBuffers.resize((size_t) voices.size());
+
+    for (auto& buffer : voiceBuffers)
+        buffer.setSize(numChannels, maximumBlockSize);
+
+    activeVoices.clear();
+    activeVoices.reserve((size_t) voices.size());
+
+    voiceStats.assign((size_t) voices.size(), VoiceStats());
+    averageSecondsPerSample = 0.0f;
+}
+
+bool ParallelSynthesiser::canUseVoiceBuffers(const juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) const noexcept
+{
+    //Voices added after prepare() have no buffer
+    return startSample + numSamples <= maximumBlockSize
+        && outputAudio.getNumChannels() <= numBufferChannels
+        && (size_t) voices.size() <= voiceBuffers.size();
+}
+
+void ParallelSynthesiser::renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples)
+{
+    if (!canUseVoiceBuffers(outputAudio, startSample, numSamples))
+    {
+        juce::Synthesiser::renderVoices(outputAudio, startSample, numSamples);
+        return;
+    }
+
+    activeVoices.clear();
+    for (int i = 0; i < voices.size(); ++i)
+    {
+        if (voices.getUnchecked(i)->isVoiceActive())
+            activeVoices.push_back(i);
+    }
+
+    const int numTasks = (int) activeVoices.size();
+
+    if (workers.isEmpty() || numTasks < parallelThreshold.load())
+    {
+        for (int index : activeVoices)
+            renderVoice(index, startSample, numSamples);
+    }
+    else
+    {
+        //Publish the job: the voices and the length are written before the counter
+        const juce::uint32 generation = getGeneration(taskCounter.load()) + 1;
+
+        jobStartSample = startSample;
+        jobNumSamples = numSamples;
+        completedTasks.store(0);
+        taskCounter.store(((juce::uint64) generation << 32) | ((juce::uint64) numTasks << 16));
+
+        for (auto* worker : workers)
+            worker->wakeUp();
+
+        //The audio thread renders too (every task no worker has taken), then waits only for the voices
+        //still rendering on the workers
+        renderTasks(generation);
+        waitForJob(numTasks);
+    }
+
+    //Mix in voice order, as the serial rendering does
+    float totalSecondsPerSample = 0.0f;
+
+    for (int index : activeVoices)
+    {
+        const auto& buffer = voiceBuffers[(size_t) index];
+
+        for (int channel = 0; channel < outputAudio.getNumChannels(); ++channel)
+            outputAudio.addFrom(channel, startSample, buffer, channel, startSample, numSamples);
+
+        totalSecondsPerSample += voiceStats[(size_t) index].secondsPerSample;
+    }
+
+    if (numTasks > 0)
+        averageSecondsPerSample = totalSecondsPerSample / (float) numTasks;
+}
+
+void ParallelSynthesiser::waitForJob(int numTasks) const noexcept
+{
+    while (completedTasks.load() < numTasks)
+        cpuPause();
+}
+
+void ParallelSynthesiser::renderTasks(juce::uint32 generation) noexcept
+{
+    for (;;)
+    {
+        juce::uint64 counter = taskCounter.load();
+
+        //A job published later, or no task left
+        if (getGeneration(counter) != generation || (counter & taskMask) >= ((counter >> 16) & taskMask))
+            return;
+
+        if (!taskCounter.compare_exchange_weak(counter, counter + 1))
+            continue;
+
+        renderVoice(activeVoices[(size_t) (counter & taskMask)], jobStartSample, jobNumSamples);
+
+        completedTasks.fetch_add(1);
+    }
+}
+
+void ParallelSynthesiser::renderVoice(int index, int startSample, int numSamples) noexcept
+{
+    auto& buffer = voiceBuffers[(size_t) index];
+    auto& stats = voiceStats[(size_t) index];
+
+    const auto start = juce::Time::getHighResolutionTicks();
+
+    buffer.clear(startSample, numSamples);
+    voices.getUnchecked(index)->renderNextBlock(buffer, startSample, numSamples);
+
+    const auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+    //The first block of a voice is often more expensive, the average follows a few blocks
+    const float secondsPerSample = static_cast<float>(seconds / numSamples);
+    stats.secondsPerSample = stats.secondsPerSample == 0.0f ? secondsPerSample
+                                                            : stats.secondsPerSample + 0.1f * (secondsPerSample - stats.secondsPerSample);
+
+    stats.peakLevel = buffer.getMagnitude(0, startSample, numSamples);
+}
+
+bool ParallelSynthesiser::isOverBudget(int numVoices) const noexcept
+{
+    const double sampleRate = getSampleRate();
+    if (averageSecondsPerSample == 0.0f || sampleRate <= 0.0)
+        return false;
+
+    //The voices are spread over the cores, the slowest core sets the time
+    const bool parallel = !workers.isEmpty() && numVoices >= parallelThreshold.load();
+    const int numCores = parallel ? workers.size() + 1 : 1;
+    const int voicesPerCore = (numVoices + numCores - 1) / numCores;
+
+    return voicesPerCore * averageSecondsPerSample * sampleRate > cpuBudget.load();
+}
+
+juce::SynthesiserVoice* ParallelSynthesiser::findFreeVoice(juce::SynthesiserSound* soundToPlay, int midiChannel,
+                                                           int midiNoteNumber, bool stealIfNoneAvailable) const
+{
+    const int limit = juce::jmin(voices.size(), voiceLimit.load());
+
+    juce::SynthesiserVoice* freeVoice = nullptr;
+    int numActive = 0;
+
+    for (int i = 0; i < voices.size(); ++i)
+    {
+        auto* voice = voices.getUnchecked(i);
+
+        if (voice->isVoiceActive())
+            ++numActive;
+        else if (freeVoice == nullptr && i < limit && voice->canPlaySound(soundToPlay))
+            freeVoice = voice;
+    }
+
+    //One more voice must also fit in the CPU budget, otherwise it takes the place of a playing one
+    if (freeVoice != nullptr && (!stealIfNoneAvailable || !isOverBudget(numActive + 1)))
+        return freeVoice;
+
+    if (stealIfNoneAvailable)
+    {
+        if (auto* voice = findVoiceToSteal(soundToPlay, midiChannel, midiNoteNumber))
+            return voice;
+    }
+
+    return freeVoice;
+}
+
+juce::SynthesiserVoice* ParallelSynthesiser::findVoiceToSteal(juce::SynthesiserSound* soundToPlay, int midiChannel,
+                                                              int midiNoteNumber) const
+{
+    juce::ignoreUnused(midiChannel);
+
+    //Levels closer than this (-60 dB) count as equal, then the oldest voice is taken
+    constexpr float levelTolerance = 0.001f;
+
+    juce::SynthesiserVoice* best = nullptr;
+    float bestLevel = 0.0f;
+
+    for (int i = 0; i < voices.size(); ++i)
+    {
+        auto* voice = voices.getUnchecked(i);
+
+        if (!voice->isVoiceActive() || !voice->canPlaySound(soundToPlay))
+            continue;
+
+        //A voice already playing this note is reused, as juce::Synthesiser does
+        if (voice->getCurrentlyPlayingNote() == midiNoteNumber)
+            return voice;
+
+        //Voices without stats yet (e.g. added after prepare) look loud, so they are kept
+        const float level = (size_t) i < voiceStats.size() ? voiceStats[(size_t) i].peakLevel : 1.0f;
+
+        if (best == nullptr)
+        {
+            best = voice;
+            bestLevel = level;
+            continue;
+        }
+
+        //Released notes first, then the quietest, then the oldest
+        if (best->isKeyDown() != voice->isKeyDown())
+        {
+            if (!voice->isKeyDown())
+            {
+                best = voice;
+                bestLevel = level;
+            }
+        }
+        else if (std::abs(level - bestLevel) > levelTolerance ? level < bestLevel : voice->wasStartedBefore(*best))
+        {
+            best = voice;
+            bestLevel = level;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_core/juce_core.h>
+#include <vector>
+
+
+//juce::Synthesiser rendering the active voices on a small pool of worker threads,
+//with a voice limit and a CPU budget for the notes it can start.
+//
+//Every voice renders into its own buffer, then the buffers are summed in voice order on the
+//audio thread: the result is the same (bit for bit) as the serial rendering, for any number of workers.
+//
+//The audio thread publishes the voices of the block in a single atomic counter,
+//workers (and the audio thread itself) take them with compare-and-swap,
+//then the audio thread waits for the completion count before mixing. The audio thread renders every
+//task no worker has taken, and the workers run at realtime priority and take one voice at a time,
+//so it only waits for the voices already started on a worker. No voice is ever left out of the mix.
+//
+//The render time and the peak level of every voice are measured on each block: when one more
+//voice would exceed the CPU budget, a new note steals the quietest (or oldest) voice instead
+//of taking a free one.
+class ParallelSynthesiser : public juce::Synthesiser
+{
+public:
+
+    //Voices to allocate up front: the limit below is changed without allocating
+    static constexpr int maxVoices = 64;
+
+    ParallelSynthesiser();
+    ~ParallelSynthesiser() override;
+
+    //Start the workers, 0 to always render serially.
+    //Call when the audio is not running (e.g. in the constructor of the processor)
+    void setNumWorkers(int numWorkers);
+    int getNumWorkers() const noexcept { return workers.size(); }
+
+    //Below this number of active voices the audio thread renders them alone
+    //(waking the workers costs more than a few voices)
+    void setParallelThreshold(int minVoices) noexcept { parallelThreshold.store(juce::jmax(1, minVoices)); }
+
+    //Number of voices new notes can use (voices above the limit finish their note)
+    void setVoiceLimit(int numVoices) noexcept { voiceLimit.store(juce::jlimit(1, maxVoices, numVoices)); }
+
+    //Fraction of the real time (per core) the voices may use before notes are stolen.
+    //Only new notes read it: a block always waits for all its voices, however long they take
+    void setCpuBudget(float fractionOfRealTime) noexcept { cpuBudget.store(fractionOfRealTime); }
+
+    //Allocate the buffers of the voices, after they were added.
+    //Blocks longer than maximumBlockSize are rendered serially.
+    void prepare(int numChannels, int maximumBlockSize);
+
+    //Number of workers that suits this machine (one core is left to the audio thread)
+    static int getDefaultNumWorkers();
+
+
+protected:
+
+    void renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) override;
+
+    juce::SynthesiserVoice* findFreeVoice(juce::SynthesiserSound* soundToPlay, int midiChannel,
+                                          int midiNoteNumber, bool stealIfNoneAvailable) const override;
+
+    //nullptr when no voice is playing
+    juce::SynthesiserVoice* findVoiceToSteal(juce::SynthesiserSound* soundToPlay, int midiChannel,
+                                             int midiNoteNumber) const override;
+
+
+private:
+
+    class Worker;
+
+    //Task counter layout: generation (32 bits) | number of tasks (16 bits) | next task (16 bits)
+    static constexpr juce::uint64 taskMask = 0xffff;
+    static juce::uint32 getGeneration(juce::uint64 counter) noexcept { return (juce::uint32) (counter >> 32); }
+
+    //Measured on the last blocks the voice played
+    struct VoiceStats
+    {
+        float peakLevel = 0.0f;
+        float secondsPerSample = 0.0f; //moving average of the render time
+    };
+
+    //Take and render tasks of the given generation until none is left
+    void renderTasks(juce::uint32 generation) noexcept;
+
+    //Audio thread: wait for the voices still rendering on the workers
+    void waitForJob(int numTasks) const noexcept;
+
+    //Render one voice into its buffer, at the same position as in the output (the voices read their
+    //parameter ramps and the LFO at their position in the block), and measure it
+    void renderVoice(int index, int startSample, int numSamples) noexcept;
+
+    bool canUseVoiceBuffers(const juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) const noexcept;
+
+    //Whether this many voices would exceed the CPU budget
+    bool isOverBudget(int numVoices) const noexcept;
+
+    juce::OwnedArray<Worker> workers;
+
+    //One buffer for each voice, and the voices active in the current block
+    std::vector<juce::AudioBuffer<float>> voiceBuffers;
+    std::vector<int> activeVoices;
+    std::vector<VoiceStats> voiceStats;
+    float averageSecondsPerSample = 0.0f;
+    int numBufferChannels = 0;
+    int maximumBlockSize = 0;
+
+    int jobStartSample = 0;
+    int jobNumSamples = 0;
+    std::atomic<juce::uint64> taskCounter{ 0 };
+    std::atomic<int> completedTasks{ 0 };
+
+    std::atomic<int> parallelThreshold{ 4 };
+    std::atomic<int> voiceLimit{ maxVoices };
+    std::atomic<float> cpuBudget{ 0.7f };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParallelSynthesiser)
+};
@@ -0,0 +1,100 @@
+#include "ParameterBinding.h"
+
+
+bool ParameterBinding::isFixedOutput(const std::string& name)
+{
+    return name == "BFRQ" || name == "NOISE_A" || name == "NOISE_C" || name == "NOTE_OFF" || name == "AMP_FLOOR";
+}
+
+void ParameterBinding::build(const InferenceBackend::OutputLayout& layout, juce::AudioProcessorValueTreeState& apvts)
+{
+    targets.fill(nullptr);
+    routingOffsets.fill(-1);
+    numValues = juce::jmin(layout.numValues, maxValues);
+
+    unboundOutputs.clear();
+    unsetParameters.clear();
+
+    std::vector<juce::RangedAudioParameter*> bound;
+
+    auto bind = [&](int index, const juce::String& parameterID) {
+        auto* parameter = apvts.getParameter(parameterID);
+
+        if (parameter == nullptr || index >= maxValues)
+            return false;
+
+        targets[(size_t) index] = parameter;
+        bound.push_back(parameter);
+        return true;
+    };
+
+    for (const auto& entry : layout.entries)
+    {
+        if (isFixedOutput(entry.name))
+            continue;
+
+        const juce::String name(entry.name);
+        bool matched = false;
+
+        const auto routing = std::find_if(ModulationRouting::names.begin(), ModulationRouting::names.end(),
+                                          [&](const ModulationRouting::Names& names) { return entry.name == names.output; });
+
+        if (routing != ModulationRouting::names.end() && entry.size == 1)
+        {
+            routingOffsets[(size_t) (routing - ModulationRouting::names.begin())] = entry.offset;
+            matched = true;
+        }
+        else if (entry.size == 1)
+        {
+            //The remapping from [0, 1] is done by the RangedAudioParameter
+            matched = bind(entry.offset, name);
+        }
+        else if (entry.size == 2)
+        {
+            //Both, or it is reported
+            const bool first = bind(entry.offset, name + "_1");
+            const bool second = bind(entry.offset + 1, name + "_2");
+            matched = first && second;
+        }
+
+        if (!matched)
+            unboundOutputs.add(name + (entry.size == 1 ? juce::String() : " (" + juce::String(entry.size) + " values)"));
+    }
+
+    for (auto* parameter : apvts.processor.getParameters())
+    {
+        auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter);
+
+        if (ranged != nullptr && std::find(bound.begin(), bound.end(), ranged) == bound.end())
+            unsetParameters.add(ranged->getParameterID());
+    }
+}
+
+int ParameterBinding::getRouting(const float* values, ModulationRouting& routing) const noexcept
+{
+    int destinations = 0;
+
+    for (size_t i = 0; i < routingOffsets.size(); ++i)
+    {
+        if (routingOffsets[i] < 0 || routingOffsets[i] >= numValues)
+            continue;
+
+        routing.depths[i] = juce::jlimit(0.0f, 1.0f, values[routingOffsets[i]]);
+        destinations |= 1 << i;
+    }
+
+    return destinations;
+}
+
+juce::String ParameterBinding::getMismatchReport() const
+{
+    juce::String report;
+
+    if (!unboundOutputs.isEmpty())
+        report << "Model outputs without a parameter: " << unboundOutputs.joinIntoString(", ") << ". ";
+
+    if (!unsetParameters.isEmpty())
+        report << "Parameters the model does not set: " << unsetParameters.joinIntoString(", ") << ".";
+
+    return report.trimEnd();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "InferenceBackend.h"
+#include "ModulationBus.h"
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <array>
+
+
+//Which plugin parameter every value of the model outputs sets, worked out once when the model is loaded:
+//applying an estimate is then a copy of the flat output array, with no name lookups.
+//An output with one value sets the parameter of the same name, an output with two values sets
+//NAME_1 and NAME_2 (one per operator). Outputs the synth keeps fixed (BFRQ, NOISE_A...) set nothing.
+//The outputs named in ModulationRouting::names set the depth of an LFO destination instead of a parameter.
+class ParameterBinding
+{
+public:
+
+    static constexpr int maxValues = 64;
+
+    using Targets = std::array<juce::RangedAudioParameter*, maxValues>;
+
+    //Outputs of the model the synth does not take: they are fixed in the synth
+    static bool isFixedOutput(const std::string& name);
+
+    //Match the outputs with the parameters of the plugin, and note what does not match
+    void build(const InferenceBackend::OutputLayout& layout, juce::AudioProcessorValueTreeState& apvts);
+
+    //The parameter set by every value of the flat output array (nullptr for the values that set nothing)
+    const Targets& getTargets() const noexcept { return targets; }
+    int getNumValues() const noexcept { return numValues; }
+
+    //Fill the depths of the LFO destinations the model outputs, from the flat output array.
+    //Returns the destinations set, one bit each (0 if the model has no routing outputs)
+    int getRouting(const float* values, ModulationRouting& routing) const noexcept;
+
+    //Outputs of the model without a parameter, and parameters of the plugin the model does not set.
+    //Empty if they match
+    juce::String getMismatchReport() const;
+
+
+private:
+
+    Targets targets{};
+    int numValues = 0;
+
+    //Position of the depth of every destination in the flat output array, -1 if the model has none
+    std::array<int, numModulationDestinations> routingOffsets{};
+
+    juce::StringArray unboundOutputs;
+    juce::StringArray unsetParameters;
+
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include "ParameterDefinitions.h"
+#include <atomic>
+#include <cstdint>
+
+
+//Changes of the synth parameters, from whatever thread the host or the GUI uses to the audio thread.
+//One bit per parameter (by SynthParameter::Index) in an atomic 64-bit mask: marking a change is a single fetch_or,
+//and processBlock takes all the changes since the previous block with one exchange.
+//No allocation, no lock and no string on either side.
+class ParameterBus
+{
+public:
+
+    static_assert(SynthParameter::numParameters <= 64, "one bit per parameter");
+
+    static constexpr std::uint64_t allParameters = SynthParameter::numParameters == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << SynthParameter::numParameters) - 1;
+
+    static constexpr std::uint64_t bit(int index) noexcept { return std::uint64_t(1) << index; }
+
+    void markChanged(int index) noexcept
+    {
+        if (index >= 0 && index < SynthParameter::numParameters)
+            dirty.fetch_or(bit(index), std::memory_order_release);
+    }
+
+    void markChanged(std::uint64_t mask) noexcept { dirty.fetch_or(mask, std::memory_order_release); }
+
+    //Audio thread: the parameters changed since the last call, and clear them
+    std::uint64_t fetchAndClear() noexcept { return dirty.exchange(0, std::memory_order_acquire); }
+
+
+private:
+
+    //Everything is dirty at the start, so the first block sets up every subsystem (e.g. the first IR)
+    std::atomic<std::uint64_t> dirty{ allParameters };
+
+};
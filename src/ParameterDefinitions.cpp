@@ -0,0 +1,28 @@
+#include "ParameterDefinitions.h"
+#include <cstring>
+
+
+juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout(float nyquist)
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+
+    for (const auto& groupDefinition : parameterGroups)
+    {
+        auto group = std::make_unique<juce::AudioProcessorParameterGroup>(groupDefinition.id, groupDefinition.name, "|");
+
+        for (const auto& definition : parameterDefinitions)
+        {
+            if (std::strcmp(definition.group, groupDefinition.id) != 0)
+                continue;
+
+            const float maximum = definition.upToNyquist ? nyquist : definition.maximum;
+
+            group->addChild(std::make_unique<juce::AudioParameterFloat>(definition.id, definition.name,
+                juce::NormalisableRange<float> { definition.minimum, maximum, definition.step }, definition.defaultValue));
+        }
+
+        layout.add(std::move(group));
+    }
+
+    return layout;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+//The automatable parameters of the synth, in the order of the plugin parameter list.
+//Their indices are known at compile time: the audio thread refers to parameters by index, never by ID,
+//and createParameterLayout() builds the APVTS from the same table, so the two cannot drift apart.
+namespace SynthParameter
+{
+    enum Index : int
+    {
+        peakA1, atA1, deA1, suA1, reA1,
+        peakA2, atA2, deA2, suA2, reA2,
+        cutFloor, peakC, atC, deC, suC, reC,
+        oscMix1, oscMix2, f0Mult,
+        qFilt,
+        lfoRate, lfoLevel,
+        mdDelay, mdDepth, mdMix,
+        revGain, revDecay,
+        numParameters
+    };
+}
+
+//What must be updated when a parameter changes (the envelopes of the voices, the response of the reverb).
+//The other parameters are read from the snapshot every block (or at note on) and need nothing
+enum class ParameterSubsystem
+{
+    none,
+    adsr1,
+    adsr2,
+    adsrC,
+    reverb
+};
+
+struct ParameterDefinition
+{
+    const char* id;
+    const char* name;
+    const char* group; //ID of the group in parameterGroups
+
+    float minimum;
+    float maximum;
+    float step;
+    float defaultValue;
+    bool upToNyquist; //the maximum is the Nyquist frequency instead
+
+    ParameterSubsystem subsystem;
+};
+
+struct ParameterGroupDefinition
+{
+    const char* id;
+    const char* name;
+};
+
+constexpr std::array<ParameterGroupDefinition, 8> parameterGroups{ {
+    { "adsr1", "ADSR1" },
+    { "adsr2", "ADSR2" },
+    { "adsrc", "ADSRC" },
+    { "oscillator", "Oscillator" },
+    { "filter", "Filter" },
+    { "lfo", "LFO" }, //(These are actually not inferred by the model but fixed, but we include them)
+    { "chorus", "Chorus" },
+    { "reverb", "Reverb" }
+} };
+
+constexpr std::array<ParameterDefinition, SynthParameter::numParameters> parameterDefinitions{ {
+    { "PEAK_A_1", "Attack amplitude (ADSR 1)", "adsr1", 0.0f, 1.0f, 0.001f, 0.01f, false, ParameterSubsystem::none },
+    { "AT_A_1", "Attack time (ADSR 1)", "adsr1", 0.0f, 4.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsr1 },
+    { "DE_A_1", "Decay time (ADSR 1)", "adsr1", 0.0f, 4.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsr1 },
+    { "SU_A_1", "Sustain level (ADSR 1)", "adsr1", 0.0f, 1.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsr1 },
+    { "RE_A_1", "Release time (ADSR 1)", "adsr1", 0.0f, 4.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsr1 },
+
+    { "PEAK_A_2", "Attack amplitude (ADSR 1)", "adsr2", 0.0f, 1.0f, 0.001f, 0.01f, false, ParameterSubsystem::none },
+    { "AT_A_2", "Attack time (ADSR 1)", "adsr2", 0.0f, 4.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsr2 },
+    { "DE_A_2", "Decay time (ADSR 1)", "adsr2", 0.0f, 4.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsr2 },
+    { "SU_A_2", "Sustain level (ADSR 1)", "adsr2", 0.0f, 1.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsr2 },
+    { "RE_A_2", "Release time (ADSR 1)", "adsr2", 0.0f, 4.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsr2 },
+
+    //The cutoff range should be adjusted (the synthesiser in the network always generates files at 16kHz)
+    { "CUT_FLOOR", "Minimum cutoff (ADSR C)", "adsrc", 30.0f, 0.0f, 1.0f, 0.01f, true, ParameterSubsystem::none },
+    { "PEAK_C", "Attack amplitude (ADSR C)", "adsrc", 30.0f, 0.0f, 1.0f, 0.01f, true, ParameterSubsystem::none },
+    { "AT_C", "Attack time (ADSR C)", "adsrc", 0.0f, 4.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsrC },
+    { "DE_C", "Decay time (ADSR C)", "adsrc", 0.0f, 4.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsrC },
+    { "SU_C", "Sustain level (ADSR C)", "adsrc", 0.0f, 1.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsrC },
+    { "RE_C", "Release time (ADSR C)", "adsrc", 0.0f, 4.0f, 0.001f, 0.01f, false, ParameterSubsystem::adsrC },
+
+    { "M_OSC_1", "Wavetype mix (Saw-Square)", "oscillator", 0.0f, 1.0f, 0.001f, 0.01f, false, ParameterSubsystem::none },
+    { "M_OSC_2", "Wavetype mix (Saw-Square)", "oscillator", 0.0f, 1.0f, 0.001f, 0.01f, false, ParameterSubsystem::none },
+    { "F0_MULT", "Frequency Ratio", "oscillator", 1.0f, 8.0f, 0.1f, 3.0f, false, ParameterSubsystem::none },
+
+    { "Q_FILT", "Q Factor", "filter", 0.02f, 2.0f, 0.001f, 0.01f, false, ParameterSubsystem::none },
+
+    { "LFO_RATE", "LFO Rate", "lfo", 0.01f, 1.0f, 0.001f, 1.0f, false, ParameterSubsystem::none },
+    { "LFO_LEVEL", "LFO Level", "lfo", 0.01f, 1.0f, 0.001f, 1.0f, false, ParameterSubsystem::none },
+
+    { "MD_DELAY", "Chorus Modulation Delay", "chorus", 0.01f, 1.0f, 0.001f, 1.0f, false, ParameterSubsystem::none },
+    { "MD_DEPTH", "Chorus Modulation Depth", "chorus", 0.01f, 1.0f, 0.001f, 1.0f, false, ParameterSubsystem::none }, // Fixed, not trained
+    { "MD_MIX", "Chorus Mix", "chorus", 0.01f, 1.0f, 0.001f, 1.0f, false, ParameterSubsystem::none },
+
+    { "REV_GAIN", "Reverb Gain", "reverb", 0.01f, 1.0f, 0.001f, 1.0f, false, ParameterSubsystem::reverb },
+    { "REV_DEC", "Reverb Decay", "reverb", 0.01f, 1.0f, 0.001f, 1.0f, false, ParameterSubsystem::reverb }
+} };
+
+inline const char* getParameterID(SynthParameter::Index index) noexcept
+{
+    return parameterDefinitions[(size_t) index].id;
+}
+
+//Bits of all the parameters that update a subsystem, for the dispatch of the ParameterBus
+constexpr std::uint64_t getSubsystemMask(ParameterSubsystem subsystem) noexcept
+{
+    std::uint64_t mask = 0;
+    for (size_t i = 0; i < parameterDefinitions.size(); ++i)
+        if (parameterDefinitions[i].subsystem == subsystem)
+            mask |= std::uint64_t(1) << i;
+    return mask;
+}
+
+//The parameters, grouped as in parameterGroups. nyquist is the maximum of the cutoff parameters
+juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout(float nyquist);
@@ -0,0 +1,204 @@
+#include "PartitionedConvolver.h"
+#include <algorithm>
+
+
+namespace
+{
+    int getFFTOrder(int blockSize)
+    {
+        //The FFT covers two blocks
+        jassert(juce::isPowerOfTwo(blockSize));
+        return juce::roundToInt(std::log2(2.0 * blockSize));
+    }
+}
+
+
+void PartitionedImpulseResponse::build(const float* impulseResponse, int length, int newBlockSize)
+{
+    blockSize = newBlockSize;
+    numPartitions = juce::jmax(1, (length + blockSize - 1) / blockSize);
+
+    const int numBins = blockSize + 1;
+    spectra.assign((size_t) numPartitions * 2 * (size_t) numBins, 0.0f);
+
+    juce::dsp::FFT fft(getFFTOrder(blockSize));
+    std::vector<float> workspace((size_t) fft.getSize() * 2);
+
+    for (int partition = 0; partition < numPartitions; ++partition)
+    {
+        //The partition, padded with zeros to the size of the FFT
+        std::fill(workspace.begin(), workspace.end(), 0.0f);
+
+        const int start = partition * blockSize;
+        const int count = juce::jmin(blockSize, length - start);
+        if (count > 0)
+            std::copy(impulseResponse + start, impulseResponse + start + count, workspace.begin());
+
+        fft.performRealOnlyForwardTransform(workspace.data(), true);
+
+        std::copy(workspace.begin(), workspace.begin() + 2 * numBins, spectra.begin() + (ptrdiff_t) partition * 2 * numBins);
+    }
+}
+
+
+PartitionedConvolver::PartitionedConvolver()
+{
+}
+
+void PartitionedConvolver::prepare(int numChannels, int newBlockSize, int newMaxPartitions)
+{
+    blockSize = newBlockSize;
+    numBins = blockSize + 1;
+    maxPartitions = juce::jmax(1, newMaxPartitions);
+
+    fft = std::make_unique<juce::dsp::FFT>(getFFTOrder(blockSize));
+
+    channels.resize((size_t) numChannels);
+    for (auto& channel : channels)
+    {
+        channel.inputBlock.assign((size_t) blockSize, 0.0f);
+        channel.outputBlock.assign((size_t) blockSize, 0.0f);
+        channel.previousInput.assign((size_t) blockSize, 0.0f);
+        channel.delayLine.assign((size_t) maxPartitions * 2 * (size_t) numBins, 0.0f);
+    }
+
+    workspace.assign((size_t) fft->getSize() * 2, 0.0f);
+    fadeOutput.assign((size_t) blockSize, 0.0f);
+
+    reset();
+}
+
+void PartitionedConvolver::reset() noexcept
+{
+    for (auto& channel : channels)
+    {
+        std::fill(channel.inputBlock.begin(), channel.inputBlock.end(), 0.0f);
+        std::fill(channel.outputBlock.begin(), channel.outputBlock.end(), 0.0f);
+        std::fill(channel.previousInput.begin(), channel.previousInput.end(), 0.0f);
+        std::fill(channel.delayLine.begin(), channel.delayLine.end(), 0.0f);
+        channel.position = 0;
+        channel.newestSpectrum = 0;
+    }
+}
+
+void PartitionedConvolver::setImpulseResponse(const PartitionedImpulseResponse* newResponse, int crossfadeSamples) noexcept
+{
+    if (newResponse == response)
+        return;
+
+    jassert(newResponse == nullptr || newResponse->blockSize == blockSize);
+
+    //A crossfade still running is cut short: wait for isCrossfading() to be false to avoid it
+    previousResponse = response;
+    response = newResponse;
+    fadeLength = juce::jmax(0, crossfadeSamples);
+
+    for (auto& channel : channels)
+        channel.fadePosition = 0;
+
+    if (fadeLength == 0)
+        previousResponse = nullptr;
+}
+
+void PartitionedConvolver::processAdding(int channelIndex, float* samples, int numSamples) noexcept
+{
+    jassert(channelIndex < (int) channels.size());
+    Channel& channel = channels[(size_t) channelIndex];
+
+    while (numSamples > 0)
+    {
+        const int count = juce::jmin(numSamples, blockSize - channel.position);
+
+        std::copy(samples, samples + count, channel.inputBlock.begin() + channel.position);
+        juce::FloatVectorOperations::add(samples, channel.outputBlock.data() + channel.position, count);
+
+        channel.position += count;
+        samples += count;
+        numSamples -= count;
+
+        if (channel.position == blockSize)
+        {
+            channel.position = 0;
+            processBlock(channel);
+        }
+    }
+
+    //The previous response is released once every channel has faded it out
+    if (fadeLength > 0 && std::all_of(channels.begin(), channels.end(), [&](const Channel& c) { return c.fadePosition >= fadeLength; }))
+    {
+        fadeLength = 0;
+        previousResponse = nullptr;
+    }
+}
+
+void PartitionedConvolver::processBlock(Channel& channel) noexcept
+{
+    //Overlap-save: the FFT window is the previous block followed by the new one
+    float* window = workspace.data();
+    std::copy(channel.previousInput.begin(), channel.previousInput.end(), window);
+    std::copy(channel.inputBlock.begin(), channel.inputBlock.end(), window + blockSize);
+    std::fill(window + 2 * blockSize, window + workspace.size(), 0.0f);
+
+    fft->performRealOnlyForwardTransform(window, true);
+
+    channel.newestSpectrum = (channel.newestSpectrum + 1) % maxPartitions;
+    std::copy(window, window + 2 * numBins, channel.delayLine.begin() + (ptrdiff_t) channel.newestSpectrum * 2 * numBins);
+
+    std::swap(channel.previousInput, channel.inputBlock);
+
+    float* output = channel.outputBlock.data();
+
+    if (response != nullptr)
+        convolve(channel, *response, output);
+    else
+        std::fill(output, output + blockSize, 0.0f);
+
+    if (fadeLength > 0 && channel.fadePosition < fadeLength)
+    {
+        if (previousResponse != nullptr)
+            convolve(channel, *previousResponse, fadeOutput.data());
+        else
+            std::fill(fadeOutput.begin(), fadeOutput.end(), 0.0f);
+
+        //Linear crossfade, sample by sample
+        const float step = 1.0f / (float) fadeLength;
+        for (int i = 0; i < blockSize; ++i)
+        {
+            const float gain = juce::jmin(1.0f, (float) (channel.fadePosition + i) * step);
+            output[i] = fadeOutput[(size_t) i] + gain * (output[i] - fadeOutput[(size_t) i]);
+        }
+
+        channel.fadePosition += blockSize;
+    }
+}
+
+void PartitionedConvolver::convolve(const Channel& channel, const PartitionedImpulseResponse& impulseResponse, float* output) noexcept
+{
+    float* accumulator = workspace.data();
+    std::fill(workspace.begin(), workspace.end(), 0.0f);
+
+    const int numPartitions = juce::jmin(impulseResponse.numPartitions, maxPartitions);
+
+    //Partition p of the response meets the input block from p blocks ago
+    for (int partition = 0; partition < numPartitions; ++partition)
+    {
+        const int index = (channel.newestSpectrum - partition + maxPartitions) % maxPartitions;
+        const float* input = channel.delayLine.data() + (size_t) index * 2 * (size_t) numBins;
+        const float* filter = impulseResponse.getSpectrum(partition);
+
+        //Complex multiply-accumulate, written out so the compiler vectorises it
+        for (int bin = 0; bin < 2 * numBins; bin += 2)
+        {
+            const float inputRe = input[bin], inputIm = input[bin + 1];
+            const float filterRe = filter[bin], filterIm = filter[bin + 1];
+
+            accumulator[bin] += inputRe * filterRe - inputIm * filterIm;
+            accumulator[bin + 1] += inputRe * filterIm + inputIm * filterRe;
+        }
+    }
+
+    fft->performRealOnlyInverseTransform(accumulator);
+
+    //The first half wraps around: the second half is the linear convolution of the new block
+    std::copy(accumulator + blockSize, accumulator + 2 * blockSize, output);
+}
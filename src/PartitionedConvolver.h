@@ -0,0 +1,90 @@
+#pragma once
+#include <juce_dsp/juce_dsp.h>
+#include <vector>
+
+
+//Impulse response cut in partitions of blockSize samples, each one transformed once (FFT of 2 * blockSize),
+//ready for a PartitionedConvolver. Building it allocates: do it off the audio thread.
+struct PartitionedImpulseResponse
+{
+    int blockSize = 0;
+    int numPartitions = 0;
+
+    //Spectrum of every partition, blockSize + 1 complex bins (re, im) each
+    std::vector<float> spectra;
+
+    void build(const float* impulseResponse, int length, int newBlockSize);
+
+    const float* getSpectrum(int partition) const noexcept { return spectra.data() + (size_t) partition * 2 * (size_t) (blockSize + 1); }
+};
+
+
+//Uniformly partitioned convolution (overlap-save, frequency-domain delay line) for any number of channels.
+//Every blockSize input samples, one FFT of the new block, a multiply-accumulate of the spectra of the last
+//numPartitions blocks with the partitions of the impulse response, and one inverse FFT: the cost per sample
+//grows with the length of the response only through the multiply-accumulate, instead of one tap per sample.
+//The output is delayed by blockSize samples.
+//
+//The delay line holds the input only, so a new response gives a full tail straight away: while it is
+//swapped in, the outputs of the old and the new responses are both computed and crossfaded.
+class PartitionedConvolver
+{
+public:
+
+    PartitionedConvolver();
+
+    //Allocates. maxPartitions is the longest response the convolver takes
+    void prepare(int numChannels, int newBlockSize, int maxPartitions);
+
+    //Forget the input
+    void reset() noexcept;
+
+    //Audio thread: use this response from now on, crossfading from the previous one over crossfadeSamples.
+    //Both must stay valid until isCrossfading() is false. nullptr fades out
+    void setImpulseResponse(const PartitionedImpulseResponse* newResponse, int crossfadeSamples) noexcept;
+
+    bool isCrossfading() const noexcept { return fadeLength > 0; }
+
+    //Audio thread: add the convolution of the samples of the channel to themselves (in place)
+    void processAdding(int channel, float* samples, int numSamples) noexcept;
+
+    int getBlockSize() const noexcept { return blockSize; }
+    int getNumChannels() const noexcept { return (int) channels.size(); }
+
+
+private:
+
+    struct Channel
+    {
+        std::vector<float> inputBlock; //blockSize samples being collected
+        std::vector<float> outputBlock; //blockSize output samples being played
+        std::vector<float> previousInput; //the block before, first half of the FFT window
+        std::vector<float> delayLine; //spectra of the last maxPartitions input blocks
+        int position = 0; //in the blocks
+        int newestSpectrum = 0; //in the delay line
+        int fadePosition = 0;
+    };
+
+    void processBlock(Channel& channel) noexcept;
+
+    //Sum of the products of the input spectra and the partitions, transformed back to blockSize samples
+    void convolve(const Channel& channel, const PartitionedImpulseResponse& response, float* output) noexcept;
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+
+    int blockSize = 0;
+    int numBins = 0;
+    int maxPartitions = 0;
+
+    std::vector<Channel> channels;
+
+    const PartitionedImpulseResponse* response = nullptr;
+    const PartitionedImpulseResponse* previousResponse = nullptr;
+    int fadeLength = 0;
+
+    //FFT workspace (2 * fft size floats) and the output of the previous response while crossfading
+    std::vector<float> workspace;
+    std::vector<float> fadeOutput;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PartitionedConvolver)
+};
@@ -25,54 +25,79 @@ FMPluginProcessor::FMPluginProcessor()
                      #endif
                        )
 #endif
-,  nn{}, apvts(*this, nullptr, "Parameters", FMPluginProcessor::createParams())//constructor of the audio components
+,  apvts(*this, nullptr, "Parameters", FMPluginProcessor::createParams()), synthParameters(apvts), settings(magicState), inferenceWorker(apvts, magicState.getPropertyRoot())//constructor of the audio components
 {
 
+    wavetableMode = &settings.add("wavetable", 0.0f);
+    parallelVoices = &settings.add("parallelVoices", 4.0f);
+    polyphony = &settings.add("polyphony", 16.0f);
+    cpuBudget = &settings.add("cpuBudget", 0.7f);
+    cullingThreshold = &settings.add("cullingThresholdDb", -100.0f);
+    filterControlInterval = &settings.add("filterControlInterval", (float) HarmonicFilter::defaultControlInterval);
+    inferenceThreads = &settings.add("inferenceThreads", 2.0f);
+    backgroundInference = &settings.add("backgroundInference", 0.0f);
+    quantisedInference = &settings.add("quantisedInference", 0.0f);
+    estimationGlide = &settings.add("estimationGlide", 0.2f);
+    freezeMode = &settings.add("freeze", 0.0f);
+    freezeNoteStep = &settings.add("freezeNoteStep", 3.0f);
+
+    for (size_t i = 0; i < lfoRouting.size(); ++i)
+        lfoRouting[i] = &settings.add(ModulationRouting::names[i].setting, 0.0f);
+
+    //The estimated parameters are applied on the message thread, as a host or the GUI would set them
+    inferenceWorker.onParametersEstimated = [this](const EstimatedParameters& estimated) {
+        applyEstimatedParameters(estimated);
+    };
+
+    //Models that estimate the LFO routing set it like the GUI does
+    inferenceWorker.onRoutingEstimated = [this](ModulationDestination destination, float depth) {
+        settings.set(ModulationRouting::names[(size_t) destination].setting, depth);
+    };
 
     //Create synth voices
 
-    //add 8 voices to the synth (allows 8 MIDI notes to be played at the same time)
+    //All the voices are allocated here, the "polyphony" setting limits how many notes can use them
 
     //synth = new juce::Synthesiser();
-    synth = std::make_unique<juce::Synthesiser>();
+    synth = std::make_unique<ParallelSynthesiser>();
     synth->addSound(new SynthSound());
+    synth->setNumWorkers(ParallelSynthesiser::getDefaultNumWorkers());
 
-    for (size_t voice = 0; voice < 8; voice++)
+    for (int voice = 0; voice < ParallelSynthesiser::maxVoices; voice++)
     {
-        synth->addVoice(new SynthVoice(&apvts));
+        synth->addVoice(new SynthVoice(&synthParameters.getSnapshot()));
 
     }
 
 
-    apvts.addParameterListener("AT_A_1", this);
-    apvts.addParameterListener("DE_A_1", this);
-    apvts.addParameterListener("SU_A_1", this);
-    apvts.addParameterListener("RE_A_1", this);
+    //Every parameter reports its changes by index, which is its SynthParameter::Index (the layout follows parameterDefinitions)
+    jassert(getParameters().size() == SynthParameter::numParameters);
 
-
-    apvts.addParameterListener("AT_A_2", this);
-    apvts.addParameterListener("DE_A_2", this);
-    apvts.addParameterListener("SU_A_2", this);
-    apvts.addParameterListener("RE_A_2", this);
-
-
-    apvts.addParameterListener("AT_C", this);
-    apvts.addParameterListener("DE_C", this);
-    apvts.addParameterListener("SU_C", this);
-    apvts.addParameterListener("RE_C", this);
-
-    apvts.addParameterListener("REV_GAIN", this);
-    apvts.addParameterListener("REV_DEC", this);
+    for (auto* parameter : getParameters())
+    {
+        jassert(dynamic_cast<juce::RangedAudioParameter*>(parameter)->paramID == getParameterID((SynthParameter::Index) parameter->getParameterIndex()));
+        parameter->addListener(this);
+    }
 
     myChooser = std::make_unique<juce::FileChooser>("Select an audio file to estimate the synthesizer parameters...",
         juce::File::getSpecialLocation(juce::File::userHomeDirectory),
         "*.wav");
 
+    modelChooser = std::make_unique<juce::FileChooser>("Select the TorchScript model...",
+        juce::File::getSpecialLocation(juce::File::userHomeDirectory),
+        "*.pt");
+
 
     magicState.setGuiValueTree(BinaryData::magic_xml, BinaryData::magic_xmlSize); //load XML
 
     //the JUCE_MODAL_LOOPS_PERMITTED=1 definition must be specified for browseForFileToOpen to work
     magicState.addTrigger("loadFile", [&] { loadFile(); });
+    magicState.addTrigger("cancelEstimation", [&] { inferenceWorker.cancel(); });
+    magicState.addTrigger("loadModel", [&] { chooseModelFile(); });
+
+    //Loaded in the background: the path saved with the state is checked again when the state is restored
+    inferenceWorker.setQuantised(quantisedInference->load() > 0.5f);
+    inferenceWorker.loadModel(InferenceWorker::findModelFile(settings.get("modelPath").toString()));
 
 
     //Add analyser for input signal
@@ -161,16 +186,25 @@ void FMPluginProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
     // initialisation that you need..
 
 
+    synthParameters.prepare(sampleRate);
+    wavetableBuilder.prepare(sampleRate);
+    chorus.prepare(sampleRate, getTotalNumOutputChannels());
+    modulationBus.prepare(sampleRate, samplesPerBlock);
+    freezeBuilder.prepare(sampleRate);
+    reverb.prepare(sampleRate, getTotalNumOutputChannels());
+
     //Prepare the synths
     for (int i = 0; i < synth->getNumVoices(); i++)
     {
         if (auto voice = dynamic_cast<SynthVoice*>(synth->getVoice(i)))
         {
             voice->prepareToPlay(sampleRate, samplesPerBlock, getTotalNumOutputChannels());
+            voice->setFilterControlInterval(static_cast<int>(filterControlInterval->load()));
         }
 
     }
     synth->setCurrentPlaybackSampleRate(sampleRate);
+    synth->prepare(getTotalNumOutputChannels(), samplesPerBlock);
 
 
     analyser->prepareToPlay(sampleRate, samplesPerBlock);
@@ -183,9 +217,8 @@ void FMPluginProcessor::releaseResources()
     // spare memory, etc.
 
 
-    //Clear synths
-    synth->clearSounds();
-    synth->clearVoices();
+    //The voices are allocated once in the constructor: only silence them, the next prepareToPlay uses them again
+    synth->allNotesOff(0, false);
 
 }
 
@@ -232,95 +265,75 @@ void FMPluginProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::Mi
 
     magicState.processMidiBuffer(midiMessages, buffer.getNumSamples());
 
+    inferenceWorker.setInferenceThreads(static_cast<int>(inferenceThreads->load()));
+    inferenceWorker.setBackgroundFriendly(backgroundInference->load() > 0.5f);
+    inferenceWorker.setQuantised(quantisedInference->load() > 0.5f);
 
+    //A new set of estimated parameters was applied: glide to it, starting with this block
+    if (glideRequested.exchange(false))
+        synthParameters.glide(estimationGlide->load());
 
-    if (fileUpdated)
-    {
-
-        fileUpdated = false;
-        myChooser->getResult();
+    //Read all the parameters once for the whole block
+    const SynthParameterSnapshot& parameters = synthParameters.update(buffer.getNumSamples());
 
-        //Perform estimation of synth params
-        juce::File audioFile = myChooser->getResult();
-        juce::AudioBuffer<float> audioBuffer = loadAudioIntoBuffer(audioFile);
+    //Update the subsystems whose parameters changed since the last block
+    const std::uint64_t changed = parameterBus.fetchAndClear();
 
-        torch::Dict<torch::IValue, torch::IValue> synthParams = estimateSynthParams(audioBuffer);
+    for (const auto& subsystem : subsystemUpdates)
+        if (changed & subsystem.parameters)
+            (this->*subsystem.update)(parameters);
 
-        updateAllParameters(synthParams);
+    //LFO for the whole block, read by the voices
+    ModulationRouting routing;
+    for (size_t i = 0; i < lfoRouting.size(); ++i)
+        routing.depths[i] = lfoRouting[i]->load();
 
-    }
+    modulationBus.update(buffer.getNumSamples(), parameters.lfoRate, parameters.lfoLevel, routing);
+    synthParameters.setModulation(&modulationBus);
 
-    if (updatedADSRa1)
+    //The notes playing from the frozen sets keep them when freeze mode is turned off.
+    //The notes are rendered for where the ramps go: a glide costs one set, not one per block
+    const bool freeze = freezeMode->load() > 0.5f;
+    if (freeze)
     {
-        updatedADSRa1 = false;
-        for (int i = 0; i < synth->getNumVoices(); ++i)
-        {
-            auto& attack = *apvts.getRawParameterValue("AT_A_1");
-            auto& decay = *apvts.getRawParameterValue("DE_A_1");
-            auto& sustain = *apvts.getRawParameterValue("SU_A_1");
-            auto& release = *apvts.getRawParameterValue("RE_A_1");
-            if (auto voice = dynamic_cast<SynthVoice*>(synth->getVoice(i)))
-            {
-                voice->updateADSRA1(attack.load(), decay.load(), sustain.load(), release.load());
-
-            }
+        //Read from the raw bytes: a MidiMessage would allocate for a long SysEx
+        for (const auto metadata : midiMessages)
+            if (metadata.numBytes == 3 && (metadata.data[0] & 0xf0) == 0x90 && metadata.data[2] > 0)
+                freezeBuilder.notePlayed(metadata.data[1]);
 
-        }
+        freezeBuilder.requestSettings(FreezeSettings::fromSnapshot(synthParameters.getTargets()), static_cast<int>(freezeNoteStep->load()));
     }
 
-    if (updatedADSRa2)
-    {
-        updatedADSRa2 = false;
-        for (int i = 0; i < synth->getNumVoices(); ++i)
-        {
-            auto& attack = *apvts.getRawParameterValue("AT_A_2");
-            auto& decay = *apvts.getRawParameterValue("DE_A_2");
-            auto& sustain = *apvts.getRawParameterValue("SU_A_2");
-            auto& release = *apvts.getRawParameterValue("RE_A_2");
-            if (auto voice = dynamic_cast<SynthVoice*>(synth->getVoice(i)))
-            {
-                voice->updateADSRA2(attack.load(), decay.load(), sustain.load(), release.load());
+    const auto frozen = freezeBuilder.update(buffer.getNumSamples());
+    synthParameters.setFrozenNotes(frozen.current, frozen.fadingOut, freeze);
 
-            }
-
-        }
-    }
-  
-
-    if (updatedADSRc)
+    //In wavetable mode the voices read the latest tables, held until the block is rendered
+    const WavetableSet* wavetables = nullptr;
+    if (wavetableMode->load() > 0.5f)
     {
-        updatedADSRc = false;
-        for (int i = 0; i < synth->getNumVoices(); ++i)
-        {
-            auto& attack = *apvts.getRawParameterValue("AT_C");
-            auto& decay = *apvts.getRawParameterValue("DE_C");
-            auto& sustain = *apvts.getRawParameterValue("SU_C");
-            auto& release = *apvts.getRawParameterValue("RE_C");
-            if (auto voice = dynamic_cast<SynthVoice*>(synth->getVoice(i)))
-            {
-                voice->updateADSRc(attack.load(), decay.load(), sustain.load(), release.load());
-
-            }
-
-        }
+        wavetableBuilder.requestSettings(getWavetableSettings(parameters));
+        wavetables = wavetableBuilder.acquire();
 
+        //Until the first tables for this sample rate are ready, the additive oscillators are used
+        if (wavetables != nullptr && wavetables->sampleRate != getSampleRate())
+            wavetables = nullptr;
     }
+    synthParameters.setWavetables(wavetables);
 
-    if (updatedReverb)
-    {
-        updatedReverb = false;
-        for (int i = 0; i < synth->getNumVoices(); ++i)
-        {
-            if (auto voice = dynamic_cast<SynthVoice*>(synth->getVoice(i)))
-            {
-                voice->updateReverb();
+    //-200 dB or lower disables the level of detail
+    synthParameters.setCullingThreshold(juce::Decibels::decibelsToGain(cullingThreshold->load(), -200.0f));
 
-            }
-        }
-    }
+    synth->setParallelThreshold(static_cast<int>(parallelVoices->load()));
+    synth->setVoiceLimit(static_cast<int>(polyphony->load()));
+    synth->setCpuBudget(cpuBudget->load());
 
     synth->renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
 
+    chorus.process(buffer, buffer.getNumSamples(), parameters.mdDelay, parameters.mdDepth, parameters.mdMix);
+    reverb.process(buffer, buffer.getNumSamples());
+
+    wavetableBuilder.release();
+
 
     analyser->pushSamples(buffer);
 
@@ -331,135 +344,121 @@ void FMPluginProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::Mi
 //==============================================================================
 
 
-void FMPluginProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+void FMPluginProcessor::parameterValueChanged(int parameterIndex, float newValue)
 {
+    juce::ignoreUnused(newValue);
 
-   
-    std::vector<std::string> tokens = split(parameterID.toStdString(), '_');
-    if (tokens[0]=="REV")
-    {
-        updatedReverb = true;
-    }
-    else {
-        if (tokens[1] == "A")
-        {
-            if (tokens[2] == "1")
-            {
-                updatedADSRa1 = true;
-            }
-            else
-            {
-                updatedADSRa2 = true;
-            }
-        }
-        else
-        {
-            updatedADSRc = true;
-        }
-    }
-
-
-
-
+    //Always marked, whoever changes it: a bit set twice (e.g. by the estimated set below) costs nothing,
+    //the subsystems are updated once per block whatever the number of changes
+    parameterBus.markChanged(parameterIndex);
 }
 
-//==============================================================================
-// This creates new instances of the plugin..
-juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+void FMPluginProcessor::parameterGestureChanged(int parameterIndex, bool gestureIsStarting)
 {
-    return new FMPluginProcessor();
+    juce::ignoreUnused(parameterIndex, gestureIsStarting);
 }
 
+const std::array<FMPluginProcessor::SubsystemUpdate, 4> FMPluginProcessor::subsystemUpdates{ {
+    { getSubsystemMask(ParameterSubsystem::adsr1), &FMPluginProcessor::updateADSR1 },
+    { getSubsystemMask(ParameterSubsystem::adsr2), &FMPluginProcessor::updateADSR2 },
+    { getSubsystemMask(ParameterSubsystem::adsrC), &FMPluginProcessor::updateADSRC },
+    { getSubsystemMask(ParameterSubsystem::reverb), &FMPluginProcessor::updateReverb }
+} };
 
-juce::AudioBuffer<float> FMPluginProcessor::loadAudioIntoBuffer(const juce::File& audioFile)
+template <typename Function>
+void FMPluginProcessor::forEachVoice(Function&& function)
 {
-
-    juce::AudioFormatManager formatManager;
-    formatManager.registerBasicFormats();
-
-    std::unique_ptr<juce::AudioFormatReader> audioReader(formatManager.createReaderFor(audioFile));
-
-    int numChannels = audioReader->numChannels; //We check this but it should always be mono
-    int numSamples = audioReader->lengthInSamples;
-
-    juce::AudioBuffer<float> audioBuffer(numChannels, numSamples);
-
-    audioReader->read(&audioBuffer, 0, numSamples, 0, true, true);
-
-    return audioBuffer;
-
+    for (int i = 0; i < synth->getNumVoices(); ++i)
+        if (auto voice = dynamic_cast<SynthVoice*>(synth->getVoice(i)))
+            function(*voice);
 }
-torch::Tensor FMPluginProcessor::audioBufferToTensor(const juce::AudioBuffer<float>& audioBuffer)
-{
-    int numChannels = audioBuffer.getNumChannels(); //We should check the audio is mono
-    DBG(numChannels);
-    int numSamples = audioBuffer.getNumSamples();
-
-    //For now just read channel 0
-    const float* channelData = audioBuffer.getReadPointer(0);
-    audioData.clear();
-    audioData.insert(audioData.end(), channelData, channelData + numSamples);
-
-    //Create the audio tensor
-    torch::Tensor tensor = torch::from_blob(audioData.data(), {numChannels, numSamples}, torch::kFloat32);
 
-    return tensor;
-}
-torch::jit::IValue FMPluginProcessor::createInputDict(torch::Tensor& audioTensor)
+void FMPluginProcessor::updateADSR1(const SynthParameterSnapshot& parameters)
 {
-    auto x = torch::Dict<std::string, torch::Tensor>();
-    x.insert("audio", audioTensor);
-    torch::jit::IValue input = torch::ivalue::from(x);
-    return input;
+    const ADSRValues& adsr = parameters.adsr1;
+    forEachVoice([&](SynthVoice& voice) { voice.updateADSRA1(adsr.attack, adsr.decay, adsr.sustain, adsr.release); });
 }
-torch::Dict<torch::IValue, torch::IValue> FMPluginProcessor::getOutputDict(torch::jit::IValue& inputDict)
-{
-
-    torch::jit::IValue output = nn.forward(inputDict); //Inference
 
-    torch::Dict<torch::IValue, torch::IValue> outputDict = output.toGenericDict(); //Convert to Dict
-
-    return outputDict;
+void FMPluginProcessor::updateADSR2(const SynthParameterSnapshot& parameters)
+{
+    const ADSRValues& adsr = parameters.adsr2;
+    forEachVoice([&](SynthVoice& voice) { voice.updateADSRA2(adsr.attack, adsr.decay, adsr.sustain, adsr.release); });
+}
 
+void FMPluginProcessor::updateADSRC(const SynthParameterSnapshot& parameters)
+{
+    const ADSRValues& adsr = parameters.adsrC;
+    forEachVoice([&](SynthVoice& voice) { voice.updateADSRc(adsr.attack, adsr.decay, adsr.sustain, adsr.release); });
+}
 
+void FMPluginProcessor::updateReverb(const SynthParameterSnapshot& parameters)
+{
+    //The new response is built in the background
+    reverb.setParameters(parameters.revGain, parameters.revDecay);
 }
-torch::Dict<torch::IValue, torch::IValue> FMPluginProcessor::estimateSynthParams(const juce::AudioBuffer<float>& audioBuffer)
+
+WavetableSettings FMPluginProcessor::getWavetableSettings(const SynthParameterSnapshot& parameters) noexcept
 {
-    torch::Tensor inputTensor = audioBufferToTensor(audioBuffer);
+    //The tables bake the cutoff reached at the sustain of ADSR C
+    WavetableSettings wavetableSettings;
+    wavetableSettings.oscMix1 = parameters.oscMix1.end;
+    wavetableSettings.oscMix2 = parameters.oscMix2.end;
+    wavetableSettings.cutoff = parameters.cutFloor.end + parameters.adsrC.sustain * (parameters.cutPeak.end - parameters.cutFloor.end);
+    wavetableSettings.q = parameters.qFilt.end;
+    wavetableSettings.f0Mult = parameters.f0Mult;
+    return wavetableSettings;
+}
 
-    DBG(inputTensor.size(0));
-    DBG(inputTensor.size(1));
+//==============================================================================
+// This creates new instances of the plugin..
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new FMPluginProcessor();
+}
 
-    torch::jit::IValue inputDict = createInputDict(inputTensor);
 
-    return getOutputDict(inputDict);
-    
-}
 void FMPluginProcessor::loadFile()
 {
-    fileUpdated = myChooser->browseForFileToOpen(); //returns true if a file was chosen
+    if (myChooser->browseForFileToOpen()) //returns true if a file was chosen
+        inferenceWorker.submit(myChooser->getResult());
 
 }
-void FMPluginProcessor::printOutputTensorEntry(torch::IValue key, torch::Dict<torch::IValue, torch::IValue>& dict)
+void FMPluginProcessor::chooseModelFile()
 {
-    std::string ref_key_str = key.toStringRef();
-    torch::Tensor ref_tensor_value = dict.at(ref_key_str).toTensor();
-
-    float float_value = *ref_tensor_value.data<float>();
-    const float* dataPtr = ref_tensor_value.data_ptr<float>();
-
-    std::string debugString = "Key: " + ref_key_str + ", Value in tensor: " + std::to_string(*dataPtr);
-    DBG(debugString);
+    if (modelChooser->browseForFileToOpen())
+    {
+        settings.set("modelPath", modelChooser->getResult().getFullPathName());
+        inferenceWorker.loadModel(modelChooser->getResult());
+    }
 }
-void FMPluginProcessor::printSynthParamsDict(torch::Dict<torch::IValue, torch::IValue> synthParamsDict)
+void FMPluginProcessor::postSetStateInformation()
 {
-    for (auto it = synthParamsDict.begin(); it != synthParamsDict.end(); ++it) {
-        //Seems like there's no other easy way to iterate over...
-        torch::IValue ref_Key = it->key();
+    const juce::File modelFile = InferenceWorker::findModelFile(settings.get("modelPath").toString());
 
-        printOutputTensorEntry(ref_Key, synthParamsDict);
-    }
+    inferenceWorker.setQuantised(quantisedInference->load() > 0.5f);
 
+    if (modelFile != inferenceWorker.getModelFile())
+        inferenceWorker.loadModel(modelFile);
+}
+void FMPluginProcessor::applyEstimatedParameters(const EstimatedParameters& estimated)
+{
+    //One transaction for the whole set: the host sees a single gesture around all the changes (one undo step).
+    //The listener marks every parameter on the bus, the subsystems are updated once in the next block.
+    //All params are normalized [0,1]. The remapping is done automatically by the RangedAudioParameter class
+    for (int i = 0; i < estimated.numValues; ++i)
+        if (auto* parameter = estimated.targets[(size_t) i])
+            parameter->beginChangeGesture();
+
+    for (int i = 0; i < estimated.numValues; ++i)
+        if (auto* parameter = estimated.targets[(size_t) i])
+            parameter->setValueNotifyingHost(estimated.values[(size_t) i]);
+
+    for (int i = 0; i < estimated.numValues; ++i)
+        if (auto* parameter = estimated.targets[(size_t) i])
+            parameter->endChangeGesture();
+
+    //Once every value is set: the audio thread glides from where the sound is to all of them
+    glideRequested.store(true);
 }
 
 
@@ -470,225 +469,10 @@ void FMPluginProcessor::addMidi(juce::MidiMessage msg, int sampleOffset)
 
 juce::AudioProcessorValueTreeState::ParameterLayout FMPluginProcessor::createParams()
 {
-    juce::AudioProcessorValueTreeState::ParameterLayout layout;
-
-    // ADSR 1 Params
-    auto peak_a_1 = std::make_unique<juce::AudioParameterFloat>("PEAK_A_1", "Attack amplitude (ADSR 1)",
-        juce::NormalisableRange<float> {0.00f, 1.0f, 0.001f}, 0.01f);
-
-    auto at_a_1 = std::make_unique<juce::AudioParameterFloat>("AT_A_1", "Attack time (ADSR 1)",
-        juce::NormalisableRange<float> {0.00f, 4.0f, 0.001f}, 0.01f);
-
-    auto de_a_1 = std::make_unique<juce::AudioParameterFloat>("DE_A_1", "Decay time (ADSR 1)",
-        juce::NormalisableRange<float> {0.00f, 4.0f, 0.001f}, 0.01f);
-
-    auto su_a_1 = std::make_unique<juce::AudioParameterFloat>("SU_A_1", "Sustain level (ADSR 1)",
-        juce::NormalisableRange<float> {0.00f, 1.0f, 0.001f}, 0.01f);
-
-    auto re_a_1 = std::make_unique<juce::AudioParameterFloat>("RE_A_1", "Release time (ADSR 1)",
-        juce::NormalisableRange<float> {0.00f, 4.0f, 0.001f}, 0.01f);
-
-    auto groupADSR1 = std::make_unique<juce::AudioProcessorParameterGroup>("adsr1", "ADSR1", "|");
-    groupADSR1->addChild(std::move(peak_a_1));
-    groupADSR1->addChild(std::move(at_a_1));
-    groupADSR1->addChild(std::move(de_a_1));
-    groupADSR1->addChild(std::move(su_a_1));
-    groupADSR1->addChild(std::move(re_a_1));
-    layout.add(std::move(groupADSR1));
-
-    // ADSR 2 Params
-    auto peak_a_2 = std::make_unique<juce::AudioParameterFloat>("PEAK_A_2", "Attack amplitude (ADSR 1)",
-        juce::NormalisableRange<float> {0.00f, 1.0f, 0.001f}, 0.01f);
-
-    auto at_a_2 = std::make_unique<juce::AudioParameterFloat>("AT_A_2", "Attack time (ADSR 1)",
-        juce::NormalisableRange<float> {0.00f, 4.0f, 0.001f}, 0.01f);
-
-    auto de_a_2 = std::make_unique<juce::AudioParameterFloat>("DE_A_2", "Decay time (ADSR 1)",
-        juce::NormalisableRange<float> {0.00f, 4.0f, 0.001f}, 0.01f);
-
-    auto su_a_2 = std::make_unique<juce::AudioParameterFloat>("SU_A_2", "Sustain level (ADSR 1)",
-        juce::NormalisableRange<float> {0.00f, 1.0f, 0.001f}, 0.01f);
-
-    auto re_a_2 = std::make_unique<juce::AudioParameterFloat>("RE_A_2", "Release time (ADSR 1)",
-        juce::NormalisableRange<float> {0.00f, 4.0f, 0.001f}, 0.01f);
-
-    auto groupADSR2 = std::make_unique<juce::AudioProcessorParameterGroup>("adsr2", "ADSR2", "|");
-    groupADSR2->addChild(std::move(peak_a_2));
-    groupADSR2->addChild(std::move(at_a_2));
-    groupADSR2->addChild(std::move(de_a_2));
-    groupADSR2->addChild(std::move(su_a_2));
-    groupADSR2->addChild(std::move(re_a_2));
-    layout.add(std::move(groupADSR2));
-
     float nyquist = getSampleRate() / 2;
     //This should be adjusted (is also not clear how we should set it, considering the synthesiser in the network always generate file at 16kHz)
     if (nyquist == 0) nyquist = 22000; //Sometimes if called at the start it will be zero. In that case we simply set this
 
-    // ADSR C Params
-    auto cut_floor = std::make_unique<juce::AudioParameterFloat>("CUT_FLOOR", "Minimum cutoff (ADSR C)",
-        juce::NormalisableRange<float> {30.0f, nyquist, 1.0f}, 0.01f);
-
-    auto peak_c = std::make_unique<juce::AudioParameterFloat>("PEAK_C", "Attack amplitude (ADSR C)",
-        juce::NormalisableRange<float> {30.0f, nyquist, 1.0f}, 0.01f);
-
-    auto at_c = std::make_unique<juce::AudioParameterFloat>("AT_C", "Attack time (ADSR C)",
-        juce::NormalisableRange<float> {0.00f, 4.0f, 0.001f}, 0.01f);
-
-    auto de_c = std::make_unique<juce::AudioParameterFloat>("DE_C", "Decay time (ADSR C)",
-        juce::NormalisableRange<float> {0.00f, 4.0f, 0.001f}, 0.01f);
-
-    auto su_c = std::make_unique<juce::AudioParameterFloat>("SU_C", "Sustain level (ADSR C)",
-        juce::NormalisableRange<float> {0.00f, 1.0f, 0.001f}, 0.01f);
-
-    auto re_c = std::make_unique<juce::AudioParameterFloat>("RE_C", "Release time (ADSR C)",
-        juce::NormalisableRange<float> {0.00f, 4.0f, 0.001f}, 0.01f);
-
-    auto groupADSRC = std::make_unique<juce::AudioProcessorParameterGroup>("adsrc", "ADSRC", "|");
-    groupADSRC->addChild(std::move(cut_floor));
-    groupADSRC->addChild(std::move(peak_c));
-    groupADSRC->addChild(std::move(at_c));
-    groupADSRC->addChild(std::move(de_c));
-    groupADSRC->addChild(std::move(su_c));
-    groupADSRC->addChild(std::move(re_c));
-    layout.add(std::move(groupADSRC));
-
-    // Oscillator params
-    auto osc_mix_1 = std::make_unique<juce::AudioParameterFloat>("M_OSC_1", "Wavetype mix (Saw-Square)",
-        juce::NormalisableRange<float> {0.00f, 1.0f, 0.001f}, 0.01f);
-
-    auto osc_mix_2 = std::make_unique<juce::AudioParameterFloat>("M_OSC_2", "Wavetype mix (Saw-Square)",
-        juce::NormalisableRange<float> {0.00f, 1.0f, 0.001f}, 0.01f);
-
-    auto f0_mult = std::make_unique<juce::AudioParameterFloat>("F0_MULT", "Frequency Ratio",
-        juce::NormalisableRange<float> {1.0f, 8.0f, 0.1f}, 3.0f);
-
-    auto groupOscillator = std::make_unique<juce::AudioProcessorParameterGroup>("oscillator", "Oscillator", "|");
-    groupOscillator->addChild(std::move(osc_mix_1));
-    groupOscillator->addChild(std::move(osc_mix_2));
-    groupOscillator->addChild(std::move(f0_mult));
-    layout.add(std::move(groupOscillator));
-
-    // Filter params
-    auto q_filt = std::make_unique<juce::AudioParameterFloat>("Q_FILT", "Q Factor",
-        juce::NormalisableRange<float> {0.02f, 2.0f, 0.001f}, 0.01f);
-    auto groupFilter = std::make_unique<juce::AudioProcessorParameterGroup>("filter", "Filter", "|");
-    groupFilter->addChild(std::move(q_filt));
-    layout.add(std::move(groupFilter));
-
-    // LFO params
-    //(These are actually not inferred by the model but fixed, but we will include them)
-    auto lfo_rate = std::make_unique<juce::AudioParameterFloat>("LFO_RATE", "LFO Rate",
-        juce::NormalisableRange<float> {0.01f, 1.0f, 0.001f}, 1.0f);
-
-    auto lfo_level = std::make_unique<juce::AudioParameterFloat>("LFO_LEVEL", "LFO Level",
-        juce::NormalisableRange<float> {0.01f, 1.0f, 0.001f}, 1.0f);
-
-    auto groupLFO = std::make_unique<juce::AudioProcessorParameterGroup>("lfo", "LFO", "|");
-    groupLFO->addChild(std::move(lfo_rate));
-    groupLFO->addChild(std::move(lfo_level));
-    layout.add(std::move(groupLFO));
-
-    // Chorus (modulated delay) params
-    auto md_delay = std::make_unique<juce::AudioParameterFloat>("MD_DELAY", "Chorus Modulation Delay",
-        juce::NormalisableRange<float> {0.01f, 1.0f, 0.001f}, 1.0f);
-
-    // Fixed, not trained
-    auto md_depth = std::make_unique<juce::AudioParameterFloat>("MD_DEPTH", "Chorus Modulation Depth",
-        juce::NormalisableRange<float> {0.01f, 1.0f, 0.001f}, 1.0f);
-
-    auto md_mix = std::make_unique<juce::AudioParameterFloat>("MD_MIX", "Chorus Mix",
-        juce::NormalisableRange<float> {0.01f, 1.0f, 0.001f}, 1.0f);
-
-    auto groupChorus = std::make_unique<juce::AudioProcessorParameterGroup>("chorus", "Chorus", "|");
-    groupChorus->addChild(std::move(md_delay));
-    groupChorus->addChild(std::move(md_depth));
-    groupChorus->addChild(std::move(md_mix));
-    layout.add(std::move(groupChorus));
-
-    // Reverb params
-    auto rev_gain = std::make_unique<juce::AudioParameterFloat>("REV_GAIN", "Reverb Gain",
-        juce::NormalisableRange<float> {0.01f, 1.0f, 0.001f}, 1.0f);
-
-    auto rev_dec = std::make_unique<juce::AudioParameterFloat>("REV_DEC", "Reverb Decay",
-        juce::NormalisableRange<float> {0.01f, 1.0f, 0.001f}, 1.0f);
-
-    auto groupReverb = std::make_unique<juce::AudioProcessorParameterGroup>("reverb", "Reverb", "|");
-    groupReverb->addChild(std::move(rev_gain));
-    groupReverb->addChild(std::move(rev_dec));
-    layout.add(std::move(groupReverb));
-
-    return layout;
-}
-
-void FMPluginProcessor::updateAllParameters(torch::Dict<torch::IValue, torch::IValue> inputDict)
-{
-    for (auto item = inputDict.begin(); item != inputDict.end(); ++item) 
-    {
-        // Extract key and value
-        torch::IValue ref_Key = item->key();
-        std::string ref_key_str = ref_Key.toStringRef();
-        torch::Tensor ref_tensor_value = inputDict.at(ref_key_str).toTensor();
-
-        ref_tensor_value = ref_tensor_value.squeeze(); //remove unnecessary dimensions
-
-        //skip some fixed parameters
-        if (ref_key_str == "BFRQ" || ref_key_str == "NOISE_A" || ref_key_str == "NOISE_C" || ref_key_str == "NOTE_OFF" || ref_key_str == "AMP_FLOOR") continue;
-
-
-        DBG("Key:" + ref_key_str + ", values:");
-
-
-        if (ref_tensor_value.dim() > 0) //tensor is a list
-        {
-
-            float val1 = *ref_tensor_value.index({ 0 }).data<float>();
-            float val2 = *ref_tensor_value.index({ 1 }).data<float>();
-
-            DBG(val1 << "," << val2);
-
-
-            //All params in tensor are normalized [0,1]. The remapping is done automatically by the RangedAudioParameter class
-
-            juce::RangedAudioParameter *p1=  magicState.getParameter(ref_key_str + "_1");
-            float denormalizedValue1 = p1->convertFrom0to1(val1); //only for debugging
-            p1->setValueNotifyingHost(val1);
-
-
-            juce::RangedAudioParameter* p2 = magicState.getParameter(ref_key_str + "_2");
-            float denormalizedValue2 = p2->convertFrom0to1(val2); //only for debugging
-            p2->setValueNotifyingHost(val2);
-
-            DBG("Denormalized: " << denormalizedValue1 << "," << denormalizedValue2);
-
-        }
-        else  //tensor is a single float element
-        {
-            float val1 = *ref_tensor_value.data<float>();
-
-            DBG(val1);
-
-            juce::RangedAudioParameter* p1 = magicState.getParameter(ref_key_str);
-            float denormalizedValue1 = p1->convertFrom0to1(val1);
-            p1->setValueNotifyingHost(val1);
-
-            DBG("Denormalized: " << denormalizedValue1);
-        }
-
-
-    }
+    return createParameterLayout(nyquist);
 }
 
-std::vector<std::string> FMPluginProcessor::split(const std::string& s, char delimiter)
-{
-    std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream tokenStream(s);
-    while (std::getline(tokenStream, token, delimiter)) {
-        tokens.push_back(token);
-    }
-    return tokens;
-}
-
-
-
-
@@ -10,7 +10,16 @@
 
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <juce_audio_utils/juce_audio_utils.h>
-#include "NeuralNetwork.h"
+#include "InferenceWorker.h"
+#include "SynthParameters.h"
+#include "ParameterBus.h"
+#include "SessionSettings.h"
+#include "Wavetables.h"
+#include "ParallelSynthesiser.h"
+#include "BusReverb.h"
+#include "BusChorus.h"
+#include "ModulationBus.h"
+#include "FreezeSampler.h"
 #include <foleys_gui_magic/foleys_gui_magic.h>
 
 
@@ -18,7 +27,7 @@
 //==============================================================================
 /**
 */
-class FMPluginProcessor  : public foleys::MagicProcessor, juce::AudioProcessorValueTreeState::Listener
+class FMPluginProcessor  : public foleys::MagicProcessor, juce::AudioProcessorParameter::Listener
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
@@ -57,94 +66,133 @@ public:
 
     //==============================================================================
 
-    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    //Any thread: mark the parameter on the bus (parameterIndex is its SynthParameter::Index)
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(int parameterIndex, bool gestureIsStarting) override;
 
 
 
     /** add some midi to be played at the sent sample offset*/
     void addMidi(juce::MidiMessage msg, int sampleOffset);
 
+    //Load the model saved with the state, if it is not the one in use
+    void postSetStateInformation() override;
+
 private:
 
     //Synth variables
 
-    std::unique_ptr<juce::Synthesiser> synth;
+    std::unique_ptr<ParallelSynthesiser> synth;
 
     //Parameters
 
     juce::AudioProcessorValueTreeState apvts;
 
+    //Typed snapshot of the parameters, updated once per block and read by the voices
+    SynthParameterCache synthParameters;
 
+    //Per-session options saved with the plugin state
+    SessionSettings settings;
 
-    //Variables for neural part
-    NeuralNetwork nn;
+    //Wavetable render mode: band-limited tables rebuilt in the background
+    //when the waveform mix or the filter change
+    std::atomic<float>* wavetableMode = nullptr;
 
+    //Minimum number of active voices rendered in parallel
+    std::atomic<float>* parallelVoices = nullptr;
 
-    //Loaded audio data
-    //We must store this as a field because if we use from_blob
-    //on this data the pointer to the original data must not be removed!
-    std::vector<float> audioData;
+    //Voices new notes can use (up to ParallelSynthesiser::maxVoices), and the share of
+    //the real time they can take before notes are stolen (it never drops a voice from a block)
+    std::atomic<float>* polyphony = nullptr;
+    std::atomic<float>* cpuBudget = nullptr;
 
+    //Threads of the parameter estimation, and whether it pauses regularly to leave the cores to the audio
+    std::atomic<float>* inferenceThreads = nullptr;
+    std::atomic<float>* backgroundInference = nullptr;
 
-    //Functions for handling tensors, audio files
-    //and inference
+    //Parameter estimation with the linear layers in int8, for slow machines
+    std::atomic<float>* quantisedInference = nullptr;
 
+    //Seconds the synth glides from the current sound to newly estimated parameters, 0 to jump
+    std::atomic<float>* estimationGlide = nullptr;
 
-    juce::AudioBuffer<float> loadAudioIntoBuffer(const juce::File& audioFile);
+    //Quality: partials and released voices below this level (dB) are not rendered
+    std::atomic<float>* cullingThreshold = nullptr;
 
-    //Convert audio buffer to tensor
-    torch::Tensor audioBufferToTensor(const juce::AudioBuffer<float>& audioBuffer);
+    //Quality: samples between two updates of the lowpass response of the harmonics (e.g. 16 or 32), applied in prepareToPlay
+    std::atomic<float>* filterControlInterval = nullptr;
 
-    //Convert the audio tensor to a tensor dict (format needed for the network input)
-    torch::jit::IValue createInputDict(torch::Tensor& audioTensor);
+    WavetableBuilder wavetableBuilder;
 
-    torch::Dict<torch::IValue, torch::IValue> getOutputDict(torch::jit::IValue& inputDict);
+    //Freeze mode: new notes play samples of the current sound, rendered in the background
+    //every freezeNoteStep semitones (the notes in between are pitch-shifted)
+    std::atomic<float>* freezeMode = nullptr;
+    std::atomic<float>* freezeNoteStep = nullptr;
+    FreezeBuilder freezeBuilder;
 
-    torch::Dict<torch::IValue, torch::IValue> estimateSynthParams(const juce::AudioBuffer<float>& audioBuffer);
+    //Depth of every LFO destination (ModulationRouting::names), set by the GUI or by the estimation
+    std::array<std::atomic<float>*, numModulationDestinations> lfoRouting{};
 
+    //LFO values of the current block, shared by all the voices
+    ModulationBus modulationBus;
 
-    //File functions
-    void loadFile();
+    //Effects on the sum of the voices: chorus, then reverb
+    BusChorus chorus;
+    BusReverb reverb;
+
+    static WavetableSettings getWavetableSettings(const SynthParameterSnapshot& parameters) noexcept;
+
+
+
+    //Variables for neural part
 
+    //Estimates the parameters from the loaded files in the background
+    //(the model and the thread are shared with the other instances)
+    InferenceWorker inferenceWorker;
 
-    void printOutputTensorEntry(torch::IValue key, torch::Dict<torch::IValue, torch::IValue>& dict); //For debugging
-    void printSynthParamsDict(torch::Dict<torch::IValue, torch::IValue> synthParamsDict); //For debugging
+    //Set the parameters estimated by the worker in one gesture (message thread), then ask the audio thread to glide
+    void applyEstimatedParameters(const EstimatedParameters& estimated);
+    std::atomic<bool> glideRequested{ false };
+
+
+    //File functions
+    void loadFile();
+    void chooseModelFile();
 
 
     //Params functions
 
     juce::AudioProcessorValueTreeState::ParameterLayout createParams(); //to initialize the parameters
 
-    void updateAllParameters(torch::Dict<torch::IValue, torch::IValue>); //Update all parameters from tensor
-
 
     /** stores messages added from the addMidi function*/
     juce::MidiBuffer midiToProcess;
 
-    const std::vector<std::string> FMPluginProcessor::parameterNames = {
-    "PEAK_A_1", "AT_A_1", "DE_A_1", "SU_A_1", "RE_A_1",
-    "PEAK_A_2", "AT_A_2", "DE_A_2", "SU_A_2", "RE_A_2",
-    "CUT_FLOOR", "PEAK_C", "AT_C", "DE_C", "SU_C", "RE_C",
-    "OSC_MIX_1", "OSC_MIX_2", "F0_MULT", "Q_FILT",
-    "LFO_RATE", "LFO_LEVEL", "MD_DELAY", "MD_DEPTH", "MD_MIX",
-    "REV_GAIN", "REV_DEC"
+    //Parameters changed since the last block, set by the listener
+    ParameterBus parameterBus;
+
+    //Dispatch of the changes: the voice subsystem to update when any of its parameters changed
+    struct SubsystemUpdate
+    {
+        std::uint64_t parameters; //ParameterBus bits
+        void (FMPluginProcessor::*update)(const SynthParameterSnapshot& parameters);
     };
 
-    std::vector<std::string> split(const std::string& s, char delimiter);
+    static const std::array<SubsystemUpdate, 4> subsystemUpdates;
+
+    void updateADSR1(const SynthParameterSnapshot& parameters);
+    void updateADSR2(const SynthParameterSnapshot& parameters);
+    void updateADSRC(const SynthParameterSnapshot& parameters);
+    void updateReverb(const SynthParameterSnapshot& parameters);
 
-    bool updatedADSRa1;
-    bool updatedADSRa2;
-    bool updatedADSRc;
+    template <typename Function>
+    void forEachVoice(Function&& function);
 
 
     //File loading
 
     std::unique_ptr<juce::FileChooser> myChooser;
-    bool fileUpdated = false;
-
-    //Reverb
-
-    bool updatedReverb = true;//Initially true so we create the first IR
+    std::unique_ptr<juce::FileChooser> modelChooser;
 
 
     //visualizer
@@ -0,0 +1,87 @@
+#include "SessionSettings.h"
+
+
+namespace
+{
+    const juce::Identifier settingsNode{ "settings" };
+}
+
+
+SessionSettings::SessionSettings(foleys::MagicGUIState& magicState)
+    : propertyRoot(magicState.getPropertyRoot())
+{
+    //The root stays the same when a state is loaded, its children are replaced
+    propertyRoot.addListener(this);
+}
+
+SessionSettings::~SessionSettings()
+{
+    propertyRoot.removeListener(this);
+}
+
+std::atomic<float>& SessionSettings::add(const juce::Identifier& name, float defaultValue)
+{
+    jassert(settings.find(name) == settings.end()); //Declared twice
+
+    auto& setting = settings[name];
+    setting = std::make_unique<Setting>();
+    setting->defaultValue = defaultValue;
+
+    auto tree = getSettingsTree();
+    if (!tree.hasProperty(name))
+        tree.setProperty(name, defaultValue, nullptr);
+
+    refresh(name, *setting);
+
+    return setting->value;
+}
+
+void SessionSettings::set(const juce::Identifier& name, const juce::var& value)
+{
+    getSettingsTree().setProperty(name, value, nullptr);
+}
+
+juce::var SessionSettings::get(const juce::Identifier& name) const
+{
+    return propertyRoot.getChildWithName(settingsNode).getProperty(name);
+}
+
+juce::ValueTree SessionSettings::getSettingsTree()
+{
+    return propertyRoot.getOrCreateChildWithName(settingsNode, nullptr);
+}
+
+void SessionSettings::refresh(const juce::Identifier& name, Setting& setting)
+{
+    auto tree = propertyRoot.getChildWithName(settingsNode);
+
+    //Properties missing from an older saved state keep their default
+    if (tree.isValid() && tree.hasProperty(name))
+        setting.value.store(static_cast<float>(tree.getProperty(name)));
+    else
+        setting.value.store(setting.defaultValue);
+}
+
+void SessionSettings::refreshAll()
+{
+    for (auto& item : settings)
+        refresh(item.first, *item.second);
+}
+
+void SessionSettings::valueTreePropertyChanged(juce::ValueTree& tree, const juce::Identifier& property)
+{
+    if (tree.getType() != settingsNode)
+        return;
+
+    auto item = settings.find(property);
+    if (item != settings.end())
+        refresh(item->first, *item->second);
+}
+
+void SessionSettings::valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& child)
+{
+    juce::ignoreUnused(parent);
+
+    if (child.getType() == settingsNode)
+        refreshAll();
+}
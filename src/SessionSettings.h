@@ -0,0 +1,49 @@
+#pragma once
+#include <foleys_gui_magic/foleys_gui_magic.h>
+#include <map>
+
+
+//Options chosen per session (render mode, quality...), which are not automatable parameters.
+//They live in the magicState properties under "settings", so they are saved with the plugin state
+//and GUI components can bind to them (e.g. property="settings:wavetable").
+//Every value is mirrored into an atomic, which the audio thread reads without touching the ValueTree.
+class SessionSettings : private juce::ValueTree::Listener
+{
+public:
+
+    SessionSettings(foleys::MagicGUIState& magicState);
+    ~SessionSettings() override;
+
+    //Declare a setting with its default value. Keep the returned reference: it stays valid
+    //as long as this object, and reading it is cheap and lock-free
+    std::atomic<float>& add(const juce::Identifier& name, float defaultValue);
+
+    //Message thread: change a setting (the GUI does it through the ValueTree directly)
+    void set(const juce::Identifier& name, const juce::var& value);
+
+    //Message thread: the saved value of a setting, also for the ones that are not numbers (e.g. paths)
+    juce::var get(const juce::Identifier& name) const;
+
+
+private:
+
+    struct Setting
+    {
+        float defaultValue = 0.0f;
+        std::atomic<float> value{ 0.0f };
+    };
+
+    juce::ValueTree getSettingsTree();
+
+    void refresh(const juce::Identifier& name, Setting& setting);
+    void refreshAll();
+
+    void valueTreePropertyChanged(juce::ValueTree& tree, const juce::Identifier& property) override;
+    void valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& child) override;
+
+    juce::ValueTree propertyRoot;
+
+    std::map<juce::Identifier, std::unique_ptr<Setting>> settings;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SessionSettings)
+};
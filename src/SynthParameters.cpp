@@ -0,0 +1,146 @@
+#include "SynthParameters.h"
+#include <algorithm>
+
+
+SynthParameterCache::SynthParameterCache(juce::AudioProcessorValueTreeState& apvts)
+{
+    //All the lookups by string happen here, only once
+    smoothedHandles[0].raw = apvts.getRawParameterValue(getParameterID(SynthParameter::oscMix1));
+    smoothedHandles[0].target = &SynthParameterSnapshot::oscMix1;
+    smoothedHandles[1].raw = apvts.getRawParameterValue(getParameterID(SynthParameter::oscMix2));
+    smoothedHandles[1].target = &SynthParameterSnapshot::oscMix2;
+    smoothedHandles[2].raw = apvts.getRawParameterValue(getParameterID(SynthParameter::cutFloor));
+    smoothedHandles[2].target = &SynthParameterSnapshot::cutFloor;
+    smoothedHandles[3].raw = apvts.getRawParameterValue(getParameterID(SynthParameter::peakC));
+    smoothedHandles[3].target = &SynthParameterSnapshot::cutPeak;
+    smoothedHandles[4].raw = apvts.getRawParameterValue(getParameterID(SynthParameter::qFilt));
+    smoothedHandles[4].target = &SynthParameterSnapshot::qFilt;
+
+    f0Mult = apvts.getRawParameterValue(getParameterID(SynthParameter::f0Mult));
+
+    adsr1 = getADSRHandles(apvts, SynthParameter::atA1);
+    adsr2 = getADSRHandles(apvts, SynthParameter::atA2);
+    adsrC = getADSRHandles(apvts, SynthParameter::atC);
+
+    revGain = apvts.getRawParameterValue(getParameterID(SynthParameter::revGain));
+    revDecay = apvts.getRawParameterValue(getParameterID(SynthParameter::revDecay));
+
+    mdDelay = apvts.getRawParameterValue(getParameterID(SynthParameter::mdDelay));
+    mdDepth = apvts.getRawParameterValue(getParameterID(SynthParameter::mdDepth));
+    mdMix = apvts.getRawParameterValue(getParameterID(SynthParameter::mdMix));
+
+    lfoRate = apvts.getRawParameterValue(getParameterID(SynthParameter::lfoRate));
+    lfoLevel = apvts.getRawParameterValue(getParameterID(SynthParameter::lfoLevel));
+
+    for (auto& handle : smoothedHandles)
+        jassert(handle.raw != nullptr);
+
+    prepare(44100.0); //just for init, the actual rate comes from prepareToPlay
+}
+
+void SynthParameterCache::prepare(double newSampleRate, double newRampLengthSeconds)
+{
+    sampleRate = newSampleRate;
+    rampLengthSeconds = newRampLengthSeconds;
+    gliding = false;
+
+    for (auto& handle : smoothedHandles)
+    {
+        handle.smoothed.reset(sampleRate, rampLengthSeconds);
+        handle.smoothed.setCurrentAndTargetValue(handle.raw->load());
+    }
+
+    update(1);
+}
+
+const SynthParameterSnapshot& SynthParameterCache::update(int numSamples)
+{
+    snapshot.numSamples = juce::jmax(1, numSamples);
+
+    for (auto& handle : smoothedHandles)
+    {
+        auto& parameter = snapshot.*(handle.target);
+
+        parameter.start = handle.smoothed.getCurrentValue();
+        handle.smoothed.setTargetValue(handle.raw->load());
+        parameter.end = handle.smoothed.skip(snapshot.numSamples);
+    }
+
+    if (gliding && std::none_of(smoothedHandles.begin(), smoothedHandles.end(),
+                                [](const SmoothedHandle& handle) { return handle.smoothed.isSmoothing(); }))
+    {
+        //reset() jumps to the target, which every ramp has reached
+        for (auto& handle : smoothedHandles)
+            handle.smoothed.reset(sampleRate, rampLengthSeconds);
+
+        gliding = false;
+    }
+
+    snapshot.f0Mult = f0Mult->load();
+
+    snapshot.adsr1 = read(adsr1);
+    snapshot.adsr2 = read(adsr2);
+    snapshot.adsrC = read(adsrC);
+
+    snapshot.revGain = revGain->load();
+    snapshot.revDecay = revDecay->load();
+
+    snapshot.mdDelay = mdDelay->load();
+    snapshot.mdDepth = mdDepth->load();
+    snapshot.mdMix = mdMix->load();
+
+    snapshot.lfoRate = lfoRate->load();
+    snapshot.lfoLevel = lfoLevel->load();
+
+    return snapshot;
+}
+
+void SynthParameterCache::glide(double seconds) noexcept
+{
+    if (seconds <= 0.0)
+        return;
+
+    for (auto& handle : smoothedHandles)
+    {
+        //reset() would jump to the target: restart the new ramp from where the parameter is now
+        const float current = handle.smoothed.getCurrentValue();
+        handle.smoothed.reset(sampleRate, seconds);
+        handle.smoothed.setCurrentAndTargetValue(current);
+    }
+
+    gliding = true;
+}
+
+SynthParameterSnapshot SynthParameterCache::getTargets() const noexcept
+{
+    SynthParameterSnapshot targets = snapshot;
+
+    for (const auto& handle : smoothedHandles)
+    {
+        const float target = handle.smoothed.getTargetValue();
+        targets.*(handle.target) = { target, target };
+    }
+
+    return targets;
+}
+
+SynthParameterCache::ADSRHandles SynthParameterCache::getADSRHandles(juce::AudioProcessorValueTreeState& apvts, SynthParameter::Index attack)
+{
+    //The four stages follow each other in parameterDefinitions
+    ADSRHandles handles;
+    handles.attack = apvts.getRawParameterValue(getParameterID(attack));
+    handles.decay = apvts.getRawParameterValue(getParameterID((SynthParameter::Index) (attack + 1)));
+    handles.sustain = apvts.getRawParameterValue(getParameterID((SynthParameter::Index) (attack + 2)));
+    handles.release = apvts.getRawParameterValue(getParameterID((SynthParameter::Index) (attack + 3)));
+    return handles;
+}
+
+ADSRValues SynthParameterCache::read(const ADSRHandles& handles) noexcept
+{
+    ADSRValues values;
+    values.attack = handles.attack->load();
+    values.decay = handles.decay->load();
+    values.sustain = handles.sustain->load();
+    values.release = handles.release->load();
+    return values;
+}
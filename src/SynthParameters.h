@@ -0,0 +1,166 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "ParameterDefinitions.h"
+#include <array>
+
+struct WavetableSet;
+class ModulationBus;
+struct FrozenNoteSet;
+
+//Continuous parameter ramped over one block by a SmoothedValue.
+//We keep only the values at the two ends of the block: the ramp is linear, so voices
+//can get the value at any sample without advancing a smoother of their own.
+struct SmoothedParameter
+{
+    float start = 0.0f;
+    float end = 0.0f;
+
+    //Value at the given sample of the block (0 = first sample)
+    float getValue(int sample, int numSamples) const noexcept
+    {
+        return start + (end - start) * static_cast<float>(sample + 1) / static_cast<float>(numSamples);
+    }
+};
+
+struct ADSRValues
+{
+    float attack = 0.0f;
+    float decay = 0.0f;
+    float sustain = 0.0f;
+    float release = 0.0f;
+};
+
+//Values of the synth parameters for one processBlock call.
+//It is filled once per block and read by every voice.
+struct SynthParameterSnapshot
+{
+    int numSamples = 1; //Length of the block the ramps refer to
+
+    //Smoothed (they are read for every sample)
+    SmoothedParameter oscMix1;
+    SmoothedParameter oscMix2;
+    SmoothedParameter cutFloor;
+    SmoothedParameter cutPeak;
+    SmoothedParameter qFilt;
+
+    //Read when a note starts, or when their change is dispatched
+    float f0Mult = 1.0f;
+
+    ADSRValues adsr1;
+    ADSRValues adsr2;
+    ADSRValues adsrC;
+
+    float revGain = 0.0f;
+    float revDecay = 0.0f;
+
+    //Chorus on the bus, in [0.01, 1] (read every block)
+    float mdDelay = 0.0f;
+    float mdDepth = 0.0f;
+    float mdMix = 0.0f;
+
+    //LFO, in [0.01, 1] (read every block by the modulation bus)
+    float lfoRate = 0.0f;
+    float lfoLevel = 0.0f;
+
+    //Precomputed LFO values for the current block, nullptr for no modulation
+    const ModulationBus* modulation = nullptr;
+
+    //Freeze mode: notes rendered in the background, played back by the voices that start while
+    //freezeNewNotes is set. The notes crossfade from frozenFadingOut as they are rendered in frozen
+    const FrozenNoteSet* frozen = nullptr;
+    const FrozenNoteSet* frozenFadingOut = nullptr;
+    bool freezeNewNotes = false;
+
+    //Tables to play in wavetable mode, nullptr for the additive oscillators
+    const WavetableSet* wavetables = nullptr;
+
+    //Level (linear) below which partials are skipped and released voices end, 0 renders everything
+    float cullingThreshold = 0.0f;
+};
+
+
+//Reads the parameters from the APVTS through cached std::atomic<float>* handles
+//(no lookups by string after construction) and builds the snapshot for each block.
+class SynthParameterCache
+{
+public:
+
+    SynthParameterCache(juce::AudioProcessorValueTreeState& apvts);
+
+    void prepare(double sampleRate, double rampLengthSeconds = 0.02);
+
+    //Call once at the start of processBlock
+    const SynthParameterSnapshot& update(int numSamples);
+
+    //Ramp the smoothed parameters to their next values over seconds instead of the usual ramp length,
+    //e.g. when a whole preset is applied. Call before update(): the ramps go back to the usual length
+    //once the glide is over. The other parameters change at the next note, as usual
+    void glide(double seconds) noexcept;
+
+    const SynthParameterSnapshot& getSnapshot() const noexcept { return snapshot; }
+
+    //The snapshot with the smoothed parameters at the end of their ramps (or of the glide)
+    SynthParameterSnapshot getTargets() const noexcept;
+
+    //Tables for the current block (nullptr to use the additive oscillators)
+    void setWavetables(const WavetableSet* wavetables) noexcept { snapshot.wavetables = wavetables; }
+
+    //Modulation bus updated for the current block (nullptr for no modulation)
+    void setModulation(const ModulationBus* modulation) noexcept { snapshot.modulation = modulation; }
+
+    //Frozen notes for the current block (see FreezeBuilder), and whether the notes starting now play them
+    void setFrozenNotes(const FrozenNoteSet* current, const FrozenNoteSet* fadingOut, bool playNewNotes) noexcept
+    {
+        snapshot.frozen = current;
+        snapshot.frozenFadingOut = fadingOut;
+        snapshot.freezeNewNotes = playNewNotes;
+    }
+
+    void setCullingThreshold(float gain) noexcept { snapshot.cullingThreshold = gain; }
+
+
+private:
+
+    struct SmoothedHandle
+    {
+        std::atomic<float>* raw = nullptr;
+        SmoothedParameter SynthParameterSnapshot::* target = nullptr;
+        juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> smoothed;
+    };
+
+    struct ADSRHandles
+    {
+        std::atomic<float>* attack = nullptr;
+        std::atomic<float>* decay = nullptr;
+        std::atomic<float>* sustain = nullptr;
+        std::atomic<float>* release = nullptr;
+    };
+
+    static ADSRHandles getADSRHandles(juce::AudioProcessorValueTreeState& apvts, SynthParameter::Index attack);
+    static ADSRValues read(const ADSRHandles& handles) noexcept;
+
+    std::array<SmoothedHandle, 5> smoothedHandles;
+
+    std::atomic<float>* f0Mult = nullptr;
+
+    ADSRHandles adsr1;
+    ADSRHandles adsr2;
+    ADSRHandles adsrC;
+
+    std::atomic<float>* revGain = nullptr;
+    std::atomic<float>* revDecay = nullptr;
+
+    std::atomic<float>* mdDelay = nullptr;
+    std::atomic<float>* mdDepth = nullptr;
+    std::atomic<float>* mdMix = nullptr;
+
+    std::atomic<float>* lfoRate = nullptr;
+    std::atomic<float>* lfoLevel = nullptr;
+
+    SynthParameterSnapshot snapshot;
+
+    double sampleRate = 44100.0;
+    double rampLengthSeconds = 0.02;
+    bool gliding = false;
+
+};
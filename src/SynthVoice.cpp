@@ -1,67 +1,19 @@
 
 
 #include "SynthVoice.h"
-#include "PluginProcessor.h"
+#include "ModulationBus.h"
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <juce_audio_utils/juce_audio_utils.h>
 
 
-SynthVoice::SynthVoice(juce::AudioProcessorValueTreeState* apvts)
+SynthVoice::SynthVoice(const SynthParameterSnapshot* parameters)
 {
 
-    this->apvts = apvts;
+    this->parameters = parameters;
 
     currentFrequency = 440; //just for init
 
-    float sumSaw = 0.0f;
-    float sumSquare = 0.0f;
-
-    //Initialize 
-    for (int k = 1; k <= 24; k++)
-    {
-        //Compute the harmonics amplitude
-        float saw = (1.0 / k) * 2 / juce::MathConstants<float>::pi;
-        int odd = (k % 2 != 0); //Only odd harmonics for the square wave
-        float square = (1.0 / k) * 4 / juce::MathConstants<float>::pi * odd;
-
-
-        harmonicsSaw.push_back(saw);
-        harmonicsSquare.push_back(square);
-
-        sumSaw += saw;
-        sumSquare += square;
-
-        //Create the oscillators
-        osc1.push_back(juce::dsp::Oscillator<float>{ [](float x) { return std::sin(x); }, 128 });
-        osc2.push_back(juce::dsp::Oscillator<float>{ [](float x) { return std::sin(x); }, 128 });
-    }
-
-    //Normalize the amplitudes
-    for (float& value : harmonicsSaw)
-    {
-        value /= sumSaw;
-    }
-
-    for (float& value : harmonicsSquare)
-    {
-        value /= sumSquare;
-    }
-
-
-    //Initialize the variables for convolutional reverb
-    //noise.setSize(1, irLength);
-    //time.setSize(1, irLength);
-    for (int i = 0; i < irLength; ++i) //skip first s
-        noise.setSample(0, i, juce::Random::getSystemRandom().nextFloat() * 2 - 1); // To have [-1, 1) range
-    noise.setSample(0, 0, 0.0); //set to zero first sample
-    for (int i = 0; i < irLength; ++i)
-        time.setSample(0, i, static_cast<float>(i) / getSampleRate()); //time ramp
-        //time.setSample(0, i, static_cast<float>(i) / static_cast<float>(irLength)); //time ramp
-
-
-    //ir.setSize(1, irLength);
-
-
+    //The reverb is applied once to the sum of the voices (BusReverb)
 }
 
 
@@ -74,16 +26,35 @@ bool SynthVoice::canPlaySound(juce::SynthesiserSound* sound)
 void SynthVoice::startNote(int midiNoteNumber, float velocity, juce::SynthesiserSound* sound, int currentPitchWheelPosition)
 {
 
-    currentFrequency = juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
-    float f0_mult = *apvts->getRawParameterValue("F0_MULT");
-
-    //Set the oscillator frequencies
-    for (int i = 1; i <= 24; ++i)
+    //Freeze mode: no oscillators nor envelopes, the note is read from the samples
+    if (parameters->freezeNewNotes && parameters->frozen != nullptr)
     {
-        osc1[i-1].setFrequency(i * currentFrequency);
-        osc2[i-1].setFrequency(i * currentFrequency * f0_mult);
+        frozenPlayer.start(midiNoteNumber);
+        return;
     }
 
+    frozenPlayer.stop();
+
+    currentFrequency = juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
+    float f0_mult = parameters->f0Mult;
+    currentF0Mult = f0_mult;
+    appliedPitchRatio = 1.0f; //the LFO is applied at the first slice
+
+    //Set the oscillator frequencies (the bank places the harmonics)
+    bank.setFrequency(0, currentFrequency);
+    bank.setFrequency(1, currentFrequency * f0_mult);
+
+    //Same for the wavetable mode: each oscillator reads the table of its own fundamental, band-limited for it
+    wavetableIndex1 = WavetableSet::getTableIndex(currentFrequency);
+    wavetableIndex2 = WavetableSet::getTableIndex(currentFrequency * f0_mult);
+    wavetableOsc1.reset();
+    wavetableOsc2.reset();
+    wavetableOsc1.setFrequency(currentFrequency, getSampleRate());
+    wavetableOsc2.setFrequency(currentFrequency * f0_mult, getSampleRate());
+
+    //The amplitudes of the previous note must not be interpolated from
+    jumpToNewAmplitudes = true;
+
     //Start the attack phase of the ADSR envelopes
     adsrOsc1.noteOn();
     adsrOsc2.noteOn();
@@ -94,6 +65,18 @@ void SynthVoice::startNote(int midiNoteNumber, float velocity, juce::Synthesiser
 
 void SynthVoice::stopNote(float velocity, bool allowTailOff)
 {
+    if (frozenPlayer.isPlaying())
+    {
+        if (allowTailOff)
+            frozenPlayer.release();
+        else
+        {
+            frozenPlayer.stop();
+            clearCurrentNote();
+        }
+
+        return;
+    }
 
     adsrOsc1.noteOff();
     adsrOsc2.noteOff();
@@ -124,23 +107,33 @@ void SynthVoice::renderNextBlock(juce::AudioBuffer<float>& outputBuffer, int sta
     if (!isVoiceActive())
         return;
 
+    if (frozenPlayer.isPlaying())
+    {
+        renderFrozen(outputBuffer, startSample, numSamples);
+        return;
+    }
 
 
-    while (--numSamples >= 0)
+    //The scratch buffers are only as long as the block size given to prepareToPlay
+    while (numSamples > 0)
     {
-        auto currentSample = computeOscOutput(0);
-
-        //if (abs(currentSample) > 1) DBG("Warning clipping");
+        const int blockSize = juce::jmin(numSamples, scratch.getNumSamples());
 
-        for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
-            outputBuffer.addSample(i, startSample, currentSample);
+        renderBlock(outputBuffer, startSample, blockSize);
 
-        startSample++;
+        startSample += blockSize;
+        numSamples -= blockSize;
     }
 
 
-    //applyReverb(outputBuffer);
-
+    //Released notes end as soon as both envelopes are below the threshold (the noise floor)
+    const float threshold = parameters->cullingThreshold;
+    if (adsrOsc1.isReleasedBelow(threshold) && adsrOsc2.isReleasedBelow(threshold))
+    {
+        adsrOsc1.reset();
+        adsrOsc2.reset();
+        adsrC.reset();
+    }
 
     bool active = adsrOsc1.isActive() || adsrOsc2.isActive();
 
@@ -151,76 +144,188 @@ void SynthVoice::renderNextBlock(juce::AudioBuffer<float>& outputBuffer, int sta
 }
 
 
-double lowpass(double freq, double cutoff, double q) {
+void SynthVoice::renderFrozen(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples)
+{
+    float* output = scratch.getWritePointer(outputOsc1Channel);
+    bool playing = true;
 
-    //The lowpass filter is implemented in the diff synth simply by multiplying the harmonics
-    //with a frequency response. This is done because IIR would be inefficient in the training process.
-    //While we could use IIR filters here instead, we try to replicate the exact behaviour for accuracy.
+    for (int offset = 0; offset < numSamples && playing; offset += scratch.getNumSamples())
+    {
+        const int blockSize = juce::jmin(numSamples - offset, scratch.getNumSamples());
 
-    //Freq: the frequency of the harmonic
-    //Cutoff: the cutoff frequency
-    //q: the q factor
+        playing = frozenPlayer.render(*parameters, output, blockSize);
 
-    double r = freq / cutoff;
-    return 1 / std::sqrt(std::pow( (1 - std::pow(r, 2.0)), 2.0) + std::pow(r / q, 2.0));
+        for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
+            outputBuffer.addFrom(i, startSample + offset, output, blockSize);
+    }
 
+    //The release tail is over (or the frozen notes are gone)
+    if (!playing)
+        clearCurrentNote();
 }
 
 
-float SynthVoice::computeOscOutput(float inputSample)
+void SynthVoice::renderBlock(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples)
 {
-    //Compute one single output sample from the first "stage" (oscillators sum) + second "stage" (filter)
+    float* envelopeOsc1 = scratch.getWritePointer(envelopeOsc1Channel);
+    float* envelopeOsc2 = scratch.getWritePointer(envelopeOsc2Channel);
+    float* envelopeC = scratch.getWritePointer(envelopeCChannel);
+    float* outputOsc1 = scratch.getWritePointer(outputOsc1Channel);
+    float* outputOsc2 = scratch.getWritePointer(outputOsc2Channel);
+
+    //The three envelopes advance once per sample, rendered for the whole block
+    adsrOsc1.renderNextBlock(envelopeOsc1, numSamples);
+    adsrOsc2.renderNextBlock(envelopeOsc2, numSamples);
+    adsrC.renderNextBlock(envelopeC, numSamples);
+
+    //Tremolo from the modulation bus, before the level of detail looks at the envelopes
+    const ModulationBus* modulation = parameters->modulation;
+    if (modulation != nullptr && modulation->isActive(ModulationDestination::amplitude))
+    {
+        float* gains = scratch.getWritePointer(modulationChannel);
+        modulation->getAmplitudeGains(gains, startSample, numSamples);
+        juce::FloatVectorOperations::multiply(envelopeOsc1, gains, numSamples);
+        juce::FloatVectorOperations::multiply(envelopeOsc2, gains, numSamples);
+    }
 
-    float output = 0.0;
-    //Outputs from the two synthesizers
+    if (auto* wavetables = parameters->wavetables)
+    {
+        //Wavetable mode: oscillators and filter are baked in the tables (the cutoff is not modulated).
+        //The pitch of the LFO changes at most once per control interval
+        for (int offset = 0; offset < numSamples; offset += ModulationBus::controlInterval)
+        {
+            const int length = juce::jmin(ModulationBus::controlInterval, numSamples - offset);
+
+            updatePitchModulation(startSample + offset);
+            wavetableOsc1.render(wavetables->getTable(0, wavetableIndex1), outputOsc1 + offset, length);
+            wavetableOsc2.render(wavetables->getTable(1, wavetableIndex2), outputOsc2 + offset, length);
+        }
+
+        //The bank amplitudes are stale if the additive mode comes back
+        jumpToNewAmplitudes = true;
+    }
+    else
+    {
+        //First "stage" (oscillators sum) + second "stage" (filter), in control-rate slices:
+        //the amplitudes of the harmonics are computed for the last sample of each slice
+        //and the bank ramps them linearly from the previous ones
+        renderAdditive(startSample, numSamples);
+    }
 
-    float oscMix1 = *apvts->getRawParameterValue("M_OSC_1");
-    float oscMix2 = *apvts->getRawParameterValue("M_OSC_2");
+    //Amplitude envelopes, then the two synths are summed
+    juce::FloatVectorOperations::multiply(outputOsc1, envelopeOsc1, numSamples);
+    juce::FloatVectorOperations::addWithMultiply(outputOsc1, outputOsc2, envelopeOsc2, numSamples);
 
-    //Retrieve the current cutoff frequency
-    //This is controlled by the ADSR. The ADSR module in juce doesn't allow changing the floor
-    //and peak values, so we must rescale them manually.
-    float adsrCSample = adsrC.getNextSample();
-    //refactor this later to avoid retrieving them every time
-    float cutFloor = *apvts->getRawParameterValue("CUT_FLOOR");
-    float cutPeak = *apvts->getRawParameterValue("PEAK_C");
-    float qFilt = *apvts->getRawParameterValue("Q_FILT");
-    float currentCutoffFrequency = adsrCSample * (cutPeak - cutFloor) + cutFloor;
+    //if (abs(currentSample) > 1) DBG("Warning clipping");
 
-    for (size_t k = 1; k <= 24; k++)
+    for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
+        outputBuffer.addFrom(i, startSample, outputOsc1, numSamples);
+}
+
+
+void SynthVoice::renderAdditive(int startSample, int numSamples)
+{
+    const float* envelopeOsc1 = scratch.getReadPointer(envelopeOsc1Channel);
+    const float* envelopeOsc2 = scratch.getReadPointer(envelopeOsc2Channel);
+    const float* envelopeC = scratch.getReadPointer(envelopeCChannel);
+    float* outputOsc1 = scratch.getWritePointer(outputOsc1Channel);
+    float* outputOsc2 = scratch.getWritePointer(outputOsc2Channel);
+
+    for (int offset = 0; offset < numSamples; offset += filterControlInterval)
     {
-        //We can do it in one single cycle (doesn't matter if we sum here or later)
+        const int length = juce::jmin(filterControlInterval, numSamples - offset);
+        const int last = offset + length - 1;
+
+        updatePitchModulation(startSample + offset);
+
+        //Loudest the amplitude envelopes get in this slice, for the level of detail
+        const float envelopeOsc1Peak = juce::FloatVectorOperations::findMaximum(envelopeOsc1 + offset, length);
+        const float envelopeOsc2Peak = juce::FloatVectorOperations::findMaximum(envelopeOsc2 + offset, length);
+
+        updateHarmonicAmplitudes(startSample + last, envelopeC[last], envelopeOsc1Peak, envelopeOsc2Peak);
+
+        if (jumpToNewAmplitudes)
+        {
+            //Nothing to ramp from at the start of a note
+            bank.jumpToTargetAmplitudes();
+            jumpToNewAmplitudes = false;
+        }
+
+        bank.render(outputOsc1 + offset, outputOsc2 + offset, length);
+    }
+}
 
-        //If above nyquist frequency stop
-        if ((k * currentFrequency) > (getSampleRate() / 2)) break;
+void SynthVoice::updatePitchModulation(int sample)
+{
+    const ModulationBus* modulation = parameters->modulation;
+    const float ratio = modulation != nullptr && modulation->isActive(ModulationDestination::pitch)
+        ? modulation->getPitchRatio(sample) : 1.0f;
 
-        //These are the same for both oscs
-        float squareAmp = harmonicsSquare.at(k - 1);
-        float sawAmp = harmonicsSaw.at(k - 1);
-        float lowpassAmp = lowpass(currentFrequency * k, currentCutoffFrequency, qFilt);
+    //Setting the bank frequency recomputes the rotation of every harmonic: skip it below 0.1 cent
+    if (std::abs(ratio - appliedPitchRatio) < 0.00006f)
+        return;
 
-        //These depends on the osc
+    appliedPitchRatio = ratio;
 
-        //OSC1
-        float sineWave = osc1[k - 1].processSample(inputSample);
-        float ampOsc = (1 - oscMix1) * sawAmp + oscMix1 * squareAmp;
+    const float frequency = currentFrequency * ratio;
+    bank.setFrequency(0, frequency);
+    bank.setFrequency(1, frequency * currentF0Mult);
+    wavetableOsc1.setFrequency(frequency, getSampleRate());
+    wavetableOsc2.setFrequency(frequency * currentF0Mult, getSampleRate());
+}
 
-        float ADSROsc = adsrOsc1.getNextSample(); //Compute adsr sample
+void SynthVoice::updateHarmonicAmplitudes(int sample, float adsrCSample, float envelopeOsc1Peak, float envelopeOsc2Peak)
+{
+    //sample is the position in the current block, used to follow the parameter ramps
 
+    //Level of detail: partials quieter than this (amplitude x lowpass x envelope) are not computed
+    const float threshold = parameters->cullingThreshold;
 
-        output += ADSROsc * ampOsc * sineWave *lowpassAmp;
+    const int numSamples = parameters->numSamples;
 
-        //OSC2
+    float oscMix1 = parameters->oscMix1.getValue(sample, numSamples);
+    float oscMix2 = parameters->oscMix2.getValue(sample, numSamples);
 
-        sineWave = osc2[k - 1].processSample(inputSample);
-        ampOsc = (1 - oscMix2) * sawAmp + oscMix2 * squareAmp;
-        ADSROsc = adsrOsc2.getNextSample();
+    //Retrieve the current cutoff frequency
+    //This is controlled by the ADSR. The ADSR module in juce doesn't allow changing the floor
+    //and peak values, so we must rescale them manually.
+    float cutFloor = parameters->cutFloor.getValue(sample, numSamples);
+    float cutPeak = parameters->cutPeak.getValue(sample, numSamples);
+    float qFilt = parameters->qFilt.getValue(sample, numSamples);
+    float currentCutoffFrequency = adsrCSample * (cutPeak - cutFloor) + cutFloor;
 
-        output += ADSROsc * ampOsc * sineWave * lowpassAmp;
+    const ModulationBus* modulation = parameters->modulation;
+    if (modulation != nullptr && modulation->isActive(ModulationDestination::cutoff))
+        currentCutoffFrequency *= modulation->getCutoffRatio(sample);
 
-    }
+    //The harmonics are where the LFO moved the pitch
+    const float fundamental = currentFrequency * appliedPitchRatio;
+
+    float lowpassGains[OscillatorBank::numHarmonics];
+    HarmonicFilter::computeGains(lowpassGains, fundamental, currentCutoffFrequency, qFilt);
 
-    return output;
+    float* ampsOsc1 = bank.getTargetAmplitudes(0);
+    float* ampsOsc2 = bank.getTargetAmplitudes(1);
+
+    for (int k = 1; k <= OscillatorBank::numHarmonics; k++)
+    {
+        //If above nyquist frequency the partial is silenced
+        if ((k * fundamental) > (getSampleRate() / 2))
+        {
+            ampsOsc1[k - 1] = 0.0f;
+            ampsOsc2[k - 1] = 0.0f;
+            continue;
+        }
+
+        //The filter is the same for both oscs, the waveform depends on the osc
+        float lowpassAmp = lowpassGains[k - 1];
+
+        float amp1 = harmonics.getAmplitude(k, oscMix1) * lowpassAmp;
+        float amp2 = harmonics.getAmplitude(k, oscMix2) * lowpassAmp;
+
+        ampsOsc1[k - 1] = amp1 * envelopeOsc1Peak < threshold ? 0.0f : amp1;
+        ampsOsc2[k - 1] = amp2 * envelopeOsc2Peak < threshold ? 0.0f : amp2;
+    }
 
 }
 
@@ -229,8 +334,9 @@ float SynthVoice::computeOscOutput(float inputSample)
 void SynthVoice::prepareToPlay(double sampleRate, int samplesPerBlock, int outputChannelsNumber)
 {
 
-    //Prepare oscillator (passing ProcessSpec)
+    //Prepare oscillator bank
 
+    bank.prepare(sampleRate);
 
     //Prepare ADSR
 
@@ -238,18 +344,9 @@ void SynthVoice::prepareToPlay(double sampleRate, int samplesPerBlock, int outpu
     adsrOsc2.setSampleRate(sampleRate);
     adsrC.setSampleRate(sampleRate);
 
+    //Envelopes and oscillator outputs of one block
+    scratch.setSize(numScratchChannels, samplesPerBlock);
 
-    
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.sampleRate = sampleRate;
-    spec.numChannels = outputChannelsNumber;
-
-
-    for (size_t i = 0; i < 24; i++)
-    {
-        osc1[i].prepare(spec);
-        osc2[i].prepare(spec);
-    }
 
 
 
@@ -257,6 +354,11 @@ void SynthVoice::prepareToPlay(double sampleRate, int samplesPerBlock, int outpu
     isPrepared = true;
 }
 
+void SynthVoice::setFilterControlInterval(int numSamples)
+{
+    filterControlInterval = juce::jmax(1, numSamples);
+}
+
 void SynthVoice::updateADSRA1(float attack, float decay, float sustain, float release)
 {
     //Scale the received values to have actuals seconds
@@ -289,38 +391,6 @@ void SynthVoice::updateADSRc(float attack, float decay, float sustain, float rel
 
 }
 
-void SynthVoice::applyReverb(const juce::AudioBuffer<float>& audio)
-{
-
-    juce::AudioSampleBuffer abfs(audio);
-    juce::dsp::AudioBlock<float> block(abfs);
-    juce::dsp::ProcessContextReplacing<float> context(block);
-    convolution.process(context);
-
-
-
-}
-
-void SynthVoice::updateReverb()
-{
-
-    //Recompute the impulse response
-
-    float gain = *apvts->getRawParameterValue("REV_GAIN");
-    float decay = *apvts->getRawParameterValue("REV_DEC");
-    ir.setSize(1, irLength);
-    for (int i = 0; i < irLength; ++i)
-        ir.setSample(0, i, gain * std::exp(-decay * time.getSample(0, i)) * noise.getSample(0, i));
-
-
-    //Update convolution object
-
-
-    convolution.reset();
-    convolution.loadImpulseResponse(std::move(ir), getSampleRate(), juce::dsp::Convolution::Stereo::no, juce::dsp::Convolution::Trim::no, juce::dsp::Convolution::Normalise::no);
-    convolution.prepare(spec);
-
-}
 
 
 
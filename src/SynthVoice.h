@@ -2,6 +2,12 @@
 #pragma once
 //#include <JuceHeader.h>
 #include "SynthSound.h"
+#include "OscillatorBank.h"
+#include "SynthParameters.h"
+#include "HarmonicFilter.h"
+#include "BlockEnvelope.h"
+#include "Wavetables.h"
+#include "FreezeSampler.h"
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <juce_dsp/juce_dsp.h>
 #include <juce_audio_utils/juce_audio_utils.h>
@@ -10,7 +16,7 @@ class SynthVoice : public juce::SynthesiserVoice
 {
 public:
 
-    SynthVoice(juce::AudioProcessorValueTreeState* apvts);
+    SynthVoice(const SynthParameterSnapshot* parameters);
 
     
 
@@ -28,6 +34,9 @@ public:
 
     void prepareToPlay(double sampleRate, int samplesPerBlock, int outputChannelsNumber);
 
+    //How often (in samples) the lowpass response of the harmonics is recomputed
+    void setFilterControlInterval(int numSamples);
+
 
     void updateADSRA1(float attack, float decay, float sustain, float release);
 
@@ -36,21 +45,43 @@ public:
     void updateADSRc(float attack, float decay, float sustain, float release);
 
 
+private:
+
 
-    void updateReverb();
+    //Harmonic components (sine functions) of both synths, 24 for each,
+    //computed together with SIMD instructions
+    OscillatorBank bank;
 
+    //The lowpass gains of the harmonics are computed at control rate
+    int filterControlInterval = HarmonicFilter::defaultControlInterval;
+    bool jumpToNewAmplitudes = true;
 
-private:
+    //Wavetable mode: the tables are shared by all the voices, each voice keeps its phases
+    WavetableOscillator wavetableOsc1;
+    WavetableOscillator wavetableOsc2;
+    int wavetableIndex1 = 0; //table of the fundamental of each oscillator
+    int wavetableIndex2 = 0;
 
+    //Freeze mode: the note is played back from the frozen notes instead
+    FrozenNotePlayer frozenPlayer;
 
-    //We use oscillators only to compute the harmonic components sine functions
-    //because they can employ a lookup table to improve performance
-    std::vector<juce::dsp::Oscillator<float>> osc1; //24 Oscillators (for each harmonic) for Synth 1
-    std::vector<juce::dsp::Oscillator<float>> osc2; //24 Oscillators (for each harmonic) for synth 2
+    BlockEnvelope adsrOsc1;
+    BlockEnvelope adsrOsc2;
+    BlockEnvelope adsrC; //ADSR for cutoff frequency
 
-    juce::ADSR adsrOsc1;
-    juce::ADSR adsrOsc2;
-    juce::ADSR adsrC; //ADSR for cutoff frequency
+    //Per-voice block buffers for the envelopes and the oscillator outputs
+    enum ScratchChannels
+    {
+        envelopeOsc1Channel,
+        envelopeOsc2Channel,
+        envelopeCChannel,
+        outputOsc1Channel,
+        outputOsc2Channel,
+        modulationChannel, //amplitude gains of the LFO
+        numScratchChannels
+    };
+
+    juce::AudioBuffer<float> scratch;
 
     juce::ADSR::Parameters adsrOsc1Params{};
     juce::ADSR::Parameters adsrOsc2Params{};
@@ -58,34 +89,36 @@ private:
 
     bool isPrepared = false;
 
-    juce::AudioProcessorValueTreeState* apvts;
-
-
-    float computeOscOutput(float inputSample);
+    //Parameters of the current block, filled by the processor
+    const SynthParameterSnapshot* parameters;
 
-    //Precomputed harmonic amplitudes for efficiency
-    std::vector<float> harmonicsSquare;
-    std::vector<float> harmonicsSaw;
 
-    //Oscillator variables
+    //Render at most scratch.getNumSamples() samples
+    void renderBlock(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples);
 
-    float currentFrequency;
+    //Freeze mode: the frozen note instead of the oscillators
+    void renderFrozen(juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples);
 
-    //Reverb
+    //Additive oscillators and filter, for the samples of renderBlock
+    void renderAdditive(int startSample, int numSamples);
 
-    int irLength = 400;
-    juce::AudioBuffer<float> noise{ 1, irLength };
-    juce::AudioBuffer<float> time{ 1, irLength };
+    //Move the oscillators to the pitch of the LFO at the given sample of the block, when it changed
+    void updatePitchModulation(int sample);
 
-    juce::AudioBuffer<float> ir{ 1, irLength }; //decaying impulse response
+    //Fill the target amplitudes of the bank for the given sample of the block
+    //(the envelope peaks are the loudest values of the amplitude envelopes until then)
+    void updateHarmonicAmplitudes(int sample, float adsrCSample, float envelopeOsc1Peak, float envelopeOsc2Peak);
 
-    juce::dsp::Convolution convolution;
+    //Precomputed harmonic amplitudes for efficiency
+    const WaveformHarmonics harmonics;
 
-    juce::dsp::ProcessSpec spec{};
+    //Oscillator variables
 
+    float currentFrequency;
+    float currentF0Mult = 1.0f;
 
+    //Frequency ratio of the LFO the oscillators are set to
+    float appliedPitchRatio = 1.0f;
 
-    void applyReverb(const juce::AudioBuffer<float>& audio);
-    
 
 };
@@ -0,0 +1,47 @@
+#include "TorchScriptBackend.h"
+#include <torch/script.h>
+#include <algorithm>
+#include <stdexcept>
+
+
+void TorchScriptBackend::load(const std::string& modelPath, Precision precision)
+{
+    network.load(modelPath, precision);
+
+    //Entries of a [1, N] pass: the values of one clip
+    layout = {};
+
+    const torch::Dict<torch::IValue, torch::IValue> exampleOutput = network.getExampleOutput().toGenericDict();
+    for (auto item = exampleOutput.begin(); item != exampleOutput.end(); ++item)
+        layout.add(item->key().toStringRef(), (int) item->value().toTensor().numel());
+}
+
+void TorchScriptBackend::estimate(const float* audio, int numClips, int numSamples, float* outputs, const SchedulingPolicy& policy)
+{
+    NeuralNetwork::applySchedulingPolicy(policy);
+    NeuralNetwork::BackgroundScope backgroundScope(policy);
+
+    //The network reads the audio in place (it does not write its input)
+    auto x = torch::Dict<std::string, torch::Tensor>();
+    x.insert("audio", torch::from_blob(const_cast<float*>(audio), { numClips, numSamples }, torch::kFloat32));
+
+    const torch::Dict<torch::IValue, torch::IValue> outputDict = network.forward(torch::ivalue::from(x)).toGenericDict();
+
+    for (const auto& entry : layout.entries)
+    {
+        const torch::Tensor value = outputDict.at(entry.name).toTensor().to(torch::kFloat32).contiguous();
+        const float* data = value.data_ptr<float>();
+
+        //Entries without a batch dimension (constants) are the same for every clip
+        const bool batched = value.dim() > 0 && value.size(0) == numClips && value.numel() == (int64_t) numClips * entry.size;
+
+        if (!batched && value.numel() != entry.size)
+            throw std::runtime_error("Unexpected size of the output " + entry.name + ": " + std::to_string(value.numel()) + " values");
+
+        for (int clip = 0; clip < numClips; ++clip)
+        {
+            const float* clipData = batched ? data + (size_t) clip * entry.size : data;
+            std::copy(clipData, clipData + entry.size, outputs + (size_t) clip * layout.numValues + entry.offset);
+        }
+    }
+}
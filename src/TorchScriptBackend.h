@@ -0,0 +1,32 @@
+#pragma once
+#include "InferenceBackend.h"
+#include "NeuralNetwork.h"
+
+
+//TorchScript models (traced or scripted in Python, e.g. traced_model.pt) run by libtorch, see NeuralNetwork.
+//int8 quantises the linear layers. The output dict of the model is flattened in its own order,
+//which the warm-up pass gives at load time
+class TorchScriptBackend : public InferenceBackend
+{
+public:
+
+    void load(const std::string& modelPath, Precision precision) override;
+
+    std::string getName() const override { return "TorchScript"; }
+
+    std::string getLoadWarnings() const override { return network.getLoadWarnings(); }
+
+    const OutputLayout& getOutputLayout() const override { return layout; }
+
+    double getSampleRate() const override { return NeuralNetwork::sampleRate; }
+    int getClipSamples() const override { return NeuralNetwork::clipSamples; }
+
+    void estimate(const float* audio, int numClips, int numSamples, float* outputs, const SchedulingPolicy& policy) override;
+
+
+private:
+
+    NeuralNetwork network;
+    OutputLayout layout;
+
+};
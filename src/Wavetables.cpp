@@ -0,0 +1,151 @@
+#include "Wavetables.h"
+
+
+bool WavetableSettings::isCloseTo(const WavetableSettings& other) const noexcept
+{
+    //Smaller changes are not audible in the baked harmonics, and rebuilding costs ~10 ms
+    return std::abs(oscMix1 - other.oscMix1) < 1.0e-3f
+        && std::abs(oscMix2 - other.oscMix2) < 1.0e-3f
+        && std::abs(cutoff - other.cutoff) < 0.005f * other.cutoff
+        && std::abs(q - other.q) < 1.0e-3f
+        && std::abs(f0Mult - other.f0Mult) < 1.0e-3f * other.f0Mult;
+}
+
+
+int WavetableSet::getTableIndex(float fundamental) noexcept
+{
+    int index = juce::roundToInt(12.0 * std::log2(fundamental / lowestFundamental));
+    return juce::jlimit(0, numTables - 1, index);
+}
+
+void WavetableSet::build(const WavetableSettings& newSettings, double newSampleRate)
+{
+    settings = newSettings;
+    sampleRate = newSampleRate;
+
+    static const WaveformHarmonics harmonics;
+
+    //One period of a sine, the harmonics are read from it with an integer stride
+    std::array<float, tableSize> sine;
+    for (size_t i = 0; i < sine.size(); ++i)
+        sine[i] = static_cast<float>(std::sin(juce::MathConstants<double>::twoPi * (double) i / tableSize));
+
+    const double nyquist = sampleRate / 2;
+    const float mixes[] = { settings.oscMix1, settings.oscMix2 };
+
+    //The filter response of the second oscillator is the one of the first: its fundamental is f0Mult lower
+    const float filterRatios[] = { 1.0f, 1.0f / juce::jmax(1.0e-3f, settings.f0Mult) };
+
+    std::array<float, HarmonicFilter::numHarmonics> gains;
+
+    for (int t = 0; t < numTables; ++t)
+    {
+        //Harmonics are dropped when they would alias at the top of the range of the table
+        //(a quarter tone above the note), the filter response is taken at the note
+        const double rangeTop = lowestFundamental * std::pow(2.0, (t + 0.5) / 12.0);
+        const double centre = lowestFundamental * std::pow(2.0, t / 12.0);
+
+        for (size_t osc = 0; osc < (size_t) OscillatorBank::numOscillators; ++osc)
+        {
+            HarmonicFilter::computeGains(gains.data(), (float) centre * filterRatios[osc], settings.cutoff, settings.q);
+
+            auto& table = tables[osc][(size_t) t];
+            std::fill(table.begin(), table.end(), 0.0f);
+
+            for (int k = 1; k <= HarmonicFilter::numHarmonics; ++k)
+            {
+                if (k * rangeTop > nyquist)
+                    break;
+
+                //Negated, as the oscillator bank starts from sin(phase - pi)
+                const float amplitude = -harmonics.getAmplitude(k, mixes[osc]) * gains[(size_t) k - 1];
+
+                for (int i = 0; i < tableSize; ++i)
+                    table[(size_t) i] += amplitude * sine[(size_t) ((k * i) & (tableSize - 1))];
+            }
+
+            table[tableSize] = table[0];
+        }
+    }
+}
+
+
+void WavetableOscillator::setFrequency(float frequency, double sampleRate) noexcept
+{
+    increment = static_cast<float>(std::fmod(frequency / sampleRate * WavetableSet::tableSize, (double) WavetableSet::tableSize));
+}
+
+void WavetableOscillator::render(const float* table, float* output, int numSamples) noexcept
+{
+    constexpr float size = static_cast<float>(WavetableSet::tableSize);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const int index = static_cast<int>(phase);
+        const float fraction = phase - static_cast<float>(index);
+
+        output[i] = table[index] + fraction * (table[index + 1] - table[index]);
+
+        phase += increment;
+        if (phase >= size)
+            phase -= size;
+    }
+}
+
+
+WavetableBuilder::WavetableBuilder()
+    : BackgroundBuilder("Wavetable builder")
+{
+    startThread();
+}
+
+WavetableBuilder::~WavetableBuilder()
+{
+    stopThread(2000);
+}
+
+void WavetableBuilder::prepare(double newSampleRate)
+{
+    //Tables built for the old rate are dropped
+    slots.reset(newSampleRate);
+    hasRequested = false;
+}
+
+void WavetableBuilder::requestSettings(const WavetableSettings& settings) noexcept
+{
+    if (hasRequested && settings.isCloseTo(lastRequest))
+        return;
+
+    lastRequest = settings;
+    hasRequested = true;
+
+    requestedMix1.store(settings.oscMix1);
+    requestedMix2.store(settings.oscMix2);
+    requestedCutoff.store(settings.cutoff);
+    requestedQ.store(settings.q);
+    requestBuild();
+}
+
+const WavetableSet* WavetableBuilder::acquire() noexcept
+{
+    //The latest tables, held until release(): no crossfade, the tables in use are replaced at once
+    slots.swapIn(false);
+    return slots.getActive();
+}
+
+void WavetableBuilder::release() noexcept
+{
+    slots.releaseActive();
+}
+
+void WavetableBuilder::build()
+{
+    WavetableSettings settings;
+    settings.oscMix1 = requestedMix1.load();
+    settings.oscMix2 = requestedMix2.load();
+    settings.cutoff = requestedCutoff.load();
+    settings.q = requestedQ.load();
+
+    slots.getFreeSlot().build(settings, slots.getSampleRate());
+    slots.publish();
+}
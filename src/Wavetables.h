@@ -0,0 +1,110 @@
+#pragma once
+#include "OscillatorBank.h"
+#include "HarmonicFilter.h"
+#include "BackgroundBuilder.h"
+#include <juce_core/juce_core.h>
+#include <array>
+
+
+//State of the synth baked into the wavetables: the waveform mix of the two oscillators,
+//a fixed lowpass (the sustain cutoff of ADSR C) and the ratio of the second oscillator
+//(its harmonics get the lowpass gains of the first one, as in the additive synth)
+struct WavetableSettings
+{
+    float oscMix1 = 0.0f;
+    float oscMix2 = 0.0f;
+    float cutoff = 1000.0f;
+    float q = 1.0f;
+    float f0Mult = 1.0f;
+
+    bool isCloseTo(const WavetableSettings& other) const noexcept;
+};
+
+
+//Band-limited tables for the two oscillators, one for each semitone of the fundamental
+//(an octave is too coarse: the lowpass response baked in the tables changes a lot within it).
+//Each oscillator reads the table of its own fundamental, so the second one is band-limited at its pitch.
+//Every table holds one period of the sum of the harmonics of the additive synth
+//(waveform x lowpass gain): playing it back costs one interpolated read per sample
+//instead of 24 partials.
+struct WavetableSet
+{
+    static constexpr int tableSize = 2048;
+    static constexpr int numTables = 128; //centred on the MIDI notes
+    static constexpr double lowestFundamental = 8.175798915643707; //MIDI note 0
+
+    //Table to use for a fundamental (the nearest MIDI note)
+    static int getTableIndex(float fundamental) noexcept;
+
+    //Table of one oscillator, with one extra guard sample for the interpolation
+    const float* getTable(int oscillator, int tableIndex) const noexcept { return tables[(size_t) oscillator][(size_t) tableIndex].data(); }
+
+    void build(const WavetableSettings& newSettings, double newSampleRate);
+
+    WavetableSettings settings;
+    double sampleRate = 0.0;
+
+private:
+
+    std::array<std::array<std::array<float, tableSize + 1>, numTables>, OscillatorBank::numOscillators> tables;
+
+};
+
+
+//Reads a table with linear interpolation, the phase is in table samples
+class WavetableOscillator
+{
+public:
+
+    void reset() noexcept { phase = 0.0f; }
+
+    void setFrequency(float frequency, double sampleRate) noexcept;
+
+    void render(const float* table, float* output, int numSamples) noexcept;
+
+private:
+
+    float phase = 0.0f;
+    float increment = 0.0f;
+
+};
+
+
+//Builds the wavetables on a background thread whenever the audio thread asks for different settings.
+//Three slots are used so that a table being read by the audio thread is never overwritten:
+//one is published, one may still be in use by the audio thread, one is free to be built.
+class WavetableBuilder : private BackgroundBuilder
+{
+public:
+
+    WavetableBuilder();
+    ~WavetableBuilder() override;
+
+    void prepare(double sampleRate);
+
+    //Audio thread: ask for tables with these settings (does nothing if they did not change)
+    void requestSettings(const WavetableSettings& settings) noexcept;
+
+    //Audio thread: the latest tables (or nullptr if none was built yet),
+    //valid until release() is called
+    const WavetableSet* acquire() noexcept;
+    void release() noexcept;
+
+
+private:
+
+    void build() override;
+
+    SlotHandover<WavetableSet, 3> slots;
+
+    //Requested settings, written by the audio thread
+    std::atomic<float> requestedMix1{ 0.0f };
+    std::atomic<float> requestedMix2{ 0.0f };
+    std::atomic<float> requestedCutoff{ 1000.0f };
+    std::atomic<float> requestedQ{ 1.0f };
+
+    WavetableSettings lastRequest; //only used by the audio thread
+    bool hasRequested = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WavetableBuilder)
+};
@@ -0,0 +1,839 @@
+#include "OscillatorBank.h"
+#include "HarmonicFilter.h"
+#include "Wavetables.h"
+#include "ParallelSynthesiser.h"
+#include "SynthVoice.h"
+#include "SynthSound.h"
+#include "PartitionedConvolver.h"
+#include "BusChorus.h"
+#include "FreezeSampler.h"
+#include <thread>
+#include <juce_dsp/juce_dsp.h>
+#include <iostream>
+#include <chrono>
+
+
+//Benchmarks for the DSP building blocks of SynthVoice.
+//Every test prints the timings and returns false if the result is not accurate enough.
+
+namespace
+{
+	constexpr double sampleRate = 44100.0;
+	constexpr int blockSize = 512;
+	constexpr int numBlocks = 2000;
+
+	double secondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void printTiming(const std::string& name, double seconds)
+	{
+		double numSamples = (double) blockSize * numBlocks;
+		std::cout << name << ": " << seconds * 1.0e9 / numSamples << " ns/sample, "
+			<< numSamples / sampleRate / seconds << "x realtime (one voice)" << std::endl;
+	}
+
+	//Parameters of a typical patch, for the tests rendering whole voices
+	SynthParameterSnapshot createSnapshot()
+	{
+		SynthParameterSnapshot snapshot;
+		snapshot.numSamples = blockSize;
+		snapshot.oscMix1 = { 0.3f, 0.3f };
+		snapshot.oscMix2 = { 0.7f, 0.7f };
+		snapshot.cutFloor = { 300.0f, 300.0f };
+		snapshot.cutPeak = { 6000.0f, 6000.0f };
+		snapshot.qFilt = { 0.7f, 0.7f };
+		snapshot.f0Mult = 2.0f;
+		return snapshot;
+	}
+
+	void addVoices(juce::Synthesiser& synth, const SynthParameterSnapshot& snapshot, int numVoices, float release = 0.1f)
+	{
+		synth.addSound(new SynthSound());
+
+		for (int i = 0; i < numVoices; ++i)
+		{
+			auto* voice = new SynthVoice(&snapshot);
+			voice->prepareToPlay(sampleRate, blockSize, 2);
+			voice->updateADSRA1(0.01f, 0.1f, 0.8f, release);
+			voice->updateADSRA2(0.02f, 0.1f, 0.5f, release);
+			voice->updateADSRc(0.05f, 0.2f, 0.3f, release);
+			synth.addVoice(voice);
+		}
+
+		synth.setCurrentPlaybackSampleRate(sampleRate);
+	}
+
+	void prepareSynth(ParallelSynthesiser& synth, const SynthParameterSnapshot& snapshot, int numVoices, float release = 0.1f)
+	{
+		addVoices(synth, snapshot, numVoices, release);
+		synth.prepare(2, blockSize);
+	}
+}
+
+
+bool benchOscillatorBank()
+{
+	//Compare the previous implementation (one juce::dsp::Oscillator for each harmonic)
+	//with the SIMD oscillator bank, using the same frequencies and amplitudes
+
+	std::cout << "Test 1: oscillator bank vs 48 juce::dsp::Oscillator" << std::endl;
+
+	const float f0 = 110.0f;
+	const float f0Mult = 3.0f;
+
+	juce::dsp::ProcessSpec spec{ sampleRate, (juce::uint32) blockSize, 1 };
+
+	std::vector<juce::dsp::Oscillator<float>> oscillators;
+	std::vector<float> amps;
+
+	OscillatorBank bank;
+	bank.prepare(sampleRate);
+	bank.setFrequency(0, f0);
+	bank.setFrequency(1, f0 * f0Mult);
+
+	for (int osc = 0; osc < OscillatorBank::numOscillators; ++osc)
+	{
+		for (int k = 1; k <= OscillatorBank::numHarmonics; ++k)
+		{
+			float amp = 1.0f / (float) (k * OscillatorBank::numHarmonics);
+
+			oscillators.push_back(juce::dsp::Oscillator<float>{ [](float x) { return std::sin(x); }, 128 });
+			oscillators.back().prepare(spec);
+			oscillators.back().setFrequency(k * f0 * (osc == 0 ? 1.0f : f0Mult), true);
+
+			amps.push_back(amp);
+			bank.getAmplitudes(osc)[k - 1] = amp;
+			bank.getTargetAmplitudes(osc)[k - 1] = amp;
+		}
+	}
+
+	std::vector<float> reference((size_t) blockSize);
+	std::vector<float> output((size_t) blockSize);
+	std::vector<float> output2((size_t) blockSize);
+
+	auto renderReference = [&]()
+	{
+		for (int n = 0; n < blockSize; ++n)
+		{
+			float sum = 0.0f;
+			for (size_t i = 0; i < oscillators.size(); ++i)
+				sum += amps[i] * oscillators[i].processSample(0.0f);
+			reference[(size_t) n] = sum;
+		}
+	};
+
+	auto getMaxError = [&]()
+	{
+		float maxError = 0.0f;
+		for (int n = 0; n < blockSize; ++n)
+			maxError = std::max(maxError, std::abs(output[(size_t) n] - reference[(size_t) n]));
+		return maxError;
+	};
+
+	//Accuracy is checked on the first block of each path
+	//(over long runs the phases of the two implementations drift apart in different ways)
+	renderReference();
+
+	for (int n = 0; n < blockSize; ++n)
+		output[(size_t) n] = bank.processSample();
+	float maxError = getMaxError();
+
+	bank.reset();
+	bank.render(output.data(), output2.data(), blockSize);
+	juce::FloatVectorOperations::add(output.data(), output2.data(), blockSize);
+	maxError = std::max(maxError, getMaxError());
+
+	//Per-object path
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int b = 0; b < numBlocks; ++b)
+		renderReference();
+	printTiming("juce::dsp::Oscillator x48", secondsSince(start));
+
+	//Bank, one sample at a time
+	start = std::chrono::high_resolution_clock::now();
+	for (int b = 0; b < numBlocks; ++b)
+	{
+		for (int n = 0; n < blockSize; ++n)
+			output[(size_t) n] = bank.processSample();
+	}
+	printTiming("OscillatorBank::processSample", secondsSince(start));
+
+	//Bank, whole blocks
+	start = std::chrono::high_resolution_clock::now();
+	for (int b = 0; b < numBlocks; ++b)
+	{
+		bank.render(output.data(), output2.data(), blockSize);
+		juce::FloatVectorOperations::add(output.data(), output2.data(), blockSize);
+	}
+	printTiming("OscillatorBank::render", secondsSince(start));
+
+	//The lookup table of juce::dsp::Oscillator has an error around 1e-4 itself
+	std::cout << "Max error against juce::dsp::Oscillator: " << maxError << std::endl;
+
+	return maxError < 1.0e-2f;
+}
+
+
+bool testHarmonicFilter()
+{
+	//The synth must keep matching the DDSP training synth:
+	//compare the float kernel (and its interpolation) with the double precision formula
+
+	std::cout << "Test 2: control-rate harmonic lowpass vs double precision formula" << std::endl;
+
+	const int numHarmonics = HarmonicFilter::numHarmonics;
+	float gains[numHarmonics];
+	double maxRelativeError = 0.0;
+
+	//Grid over the ranges of the plugin parameters (CUT_FLOOR/PEAK_C and Q_FILT)
+	for (float f0 = 30.0f; f0 < 4000.0f; f0 *= 1.5f)
+	{
+		for (float cutoff = 30.0f; cutoff < 22050.0f; cutoff *= 1.3f)
+		{
+			for (float q = 0.02f; q <= 2.0f; q *= 1.7f)
+			{
+				HarmonicFilter::computeGains(gains, f0, cutoff, q);
+
+				for (int k = 1; k <= numHarmonics; ++k)
+				{
+					double reference = HarmonicFilter::lowpass((double) f0 * k, cutoff, q);
+					maxRelativeError = std::max(maxRelativeError, std::abs(gains[k - 1] - reference) / reference);
+				}
+			}
+		}
+	}
+
+	std::cout << "Max relative error of the float kernel: " << maxRelativeError << std::endl;
+
+	//Interpolation: a cutoff sweep like the one of an ADSR attack (30 Hz to 8 kHz in 50 ms)
+	for (int interval : { 16, 32 })
+	{
+		const float f0 = 110.0f;
+		const float q = 0.7f;
+		const int sweepLength = (int) (0.05 * sampleRate);
+
+		double maxInterpolationError = 0.0;
+
+		auto getCutoff = [&](int n) { return 30.0f + (8000.0f - 30.0f) * (float) n / (float) sweepLength; };
+
+		//Gains at the start and at the end of each interval, linear ramp in between
+		float startGains[numHarmonics];
+		float endGains[numHarmonics];
+		HarmonicFilter::computeGains(startGains, f0, getCutoff(0), q);
+
+		for (int intervalStart = 0; intervalStart < sweepLength; intervalStart += interval)
+		{
+			HarmonicFilter::computeGains(endGains, f0, getCutoff(intervalStart + interval - 1), q);
+
+			for (int n = 0; n < interval; ++n)
+			{
+				float cutoff = getCutoff(intervalStart + n);
+				float proportion = (float) (n + 1) / (float) interval;
+
+				for (int k = 1; k <= numHarmonics; ++k)
+				{
+					float gain = startGains[k - 1] + (endGains[k - 1] - startGains[k - 1]) * proportion;
+					double reference = HarmonicFilter::lowpass((double) f0 * k, cutoff, q);
+					maxInterpolationError = std::max(maxInterpolationError, std::abs(gain - reference));
+				}
+			}
+
+			std::copy(endGains, endGains + numHarmonics, startGains);
+		}
+
+		std::cout << "Max gain error with interpolation every " << interval << " samples: " << maxInterpolationError << std::endl;
+	}
+
+	//Speed of the two versions for one set of 24 gains
+	const int numRuns = 100000;
+	volatile double sink = 0.0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < numRuns; ++i)
+	{
+		for (int k = 1; k <= numHarmonics; ++k)
+			sink = sink + HarmonicFilter::lowpass(110.0 * k, 1000.0 + i % 100, 0.7);
+	}
+	std::cout << "lowpass() x24: " << secondsSince(start) * 1.0e9 / numRuns << " ns" << std::endl;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < numRuns; ++i)
+	{
+		HarmonicFilter::computeGains(gains, 110.0f, 1000.0f + (float) (i % 100), 0.7f);
+		sink = sink + gains[0];
+	}
+	std::cout << "HarmonicFilter::computeGains: " << secondsSince(start) * 1.0e9 / numRuns << " ns" << std::endl;
+
+	return maxRelativeError < 1.0e-4;
+}
+
+
+bool testWavetables()
+{
+	//Wavetable mode approximates the additive synth: the filter gains are taken at the note
+	//of each table, and harmonics are cut a quarter tone above it.
+	//Report the error against the additive oscillators for a held note, across the keyboard
+	//(detuned by 30 cents, so the filter is not evaluated exactly at the table note).
+	//The second oscillator plays F0_MULT times higher (3, as in the default patch): it reads the table of its own
+	//pitch, compared with its additive harmonics below Nyquist (filtered like those of the first oscillator).
+
+	std::cout << "Test 3: wavetable mode vs additive oscillators" << std::endl;
+
+	WavetableSettings settings;
+	settings.oscMix1 = 0.3f;
+	settings.oscMix2 = 0.7f;
+	settings.cutoff = 2000.0f;
+	settings.q = 0.7f;
+	settings.f0Mult = 3.0f;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	auto tables = std::make_unique<WavetableSet>();
+	tables->build(settings, sampleRate);
+	std::cout << "Table build: " << secondsSince(start) * 1.0e3 << " ms" << std::endl;
+
+	const WaveformHarmonics harmonics;
+	const int length = (int) sampleRate; //one second
+	std::vector<float> additive((size_t) length), additiveOsc2((size_t) length), wavetable((size_t) length), wavetableOsc2((size_t) length);
+
+	auto getErrorDb = [length](const std::vector<float>& expected, const std::vector<float>& actual)
+	{
+		double signal = 0.0, error = 0.0;
+		for (int i = 0; i < length; ++i)
+		{
+			signal += (double) expected[(size_t) i] * expected[(size_t) i];
+			error += ((double) actual[(size_t) i] - expected[(size_t) i]) * ((double) actual[(size_t) i] - expected[(size_t) i]);
+		}
+
+		return 10.0 * std::log10(error / signal + 1.0e-20);
+	};
+
+	double worstErrorDb = -200.0;
+
+	for (int note = 24; note <= 108; note += 7)
+	{
+		const float f0 = (float) juce::MidiMessage::getMidiNoteInHertz(note) * std::pow(2.0f, 0.3f / 12.0f);
+		const float f2 = f0 * settings.f0Mult;
+
+		OscillatorBank bank;
+		bank.prepare(sampleRate);
+		bank.setFrequency(0, f0);
+		bank.setFrequency(1, f2);
+
+		float gains[OscillatorBank::numHarmonics];
+		HarmonicFilter::computeGains(gains, f0, settings.cutoff, settings.q);
+
+		for (int k = 1; k <= OscillatorBank::numHarmonics; ++k)
+		{
+			float amplitude = k * f0 > sampleRate / 2 ? 0.0f : harmonics.getAmplitude(k, settings.oscMix1) * gains[k - 1];
+			bank.getAmplitudes(0)[k - 1] = bank.getTargetAmplitudes(0)[k - 1] = amplitude;
+
+			float amplitude2 = k * f2 > sampleRate / 2 ? 0.0f : harmonics.getAmplitude(k, settings.oscMix2) * gains[k - 1];
+			bank.getAmplitudes(1)[k - 1] = bank.getTargetAmplitudes(1)[k - 1] = amplitude2;
+		}
+
+		bank.render(additive.data(), additiveOsc2.data(), length);
+
+		WavetableOscillator oscillator, oscillator2;
+		oscillator.setFrequency(f0, sampleRate);
+		oscillator.render(tables->getTable(0, WavetableSet::getTableIndex(f0)), wavetable.data(), length);
+		oscillator2.setFrequency(f2, sampleRate);
+		oscillator2.render(tables->getTable(1, WavetableSet::getTableIndex(f2)), wavetableOsc2.data(), length);
+
+		const double errorDb = getErrorDb(additive, wavetable);
+		const double errorOsc2Db = getErrorDb(additiveOsc2, wavetableOsc2);
+		worstErrorDb = std::max(worstErrorDb, std::max(errorDb, errorOsc2Db));
+
+		std::cout << "Note " << note << " (" << f0 << " Hz): error " << errorDb << " dB, second oscillator ("
+			<< f2 << " Hz) " << errorOsc2Db << " dB" << std::endl;
+	}
+
+	std::cout << "Worst error: " << worstErrorDb << " dB" << std::endl;
+
+	//Speed for one voice (both oscillators), against the additive bank
+	OscillatorBank bank;
+	bank.prepare(sampleRate);
+	bank.setFrequency(0, 110.0f);
+	bank.setFrequency(1, 330.0f);
+	std::fill(bank.getAmplitudes(0), bank.getAmplitudes(0) + OscillatorBank::numPartials, 0.01f);
+	std::fill(bank.getTargetAmplitudes(0), bank.getTargetAmplitudes(0) + OscillatorBank::numPartials, 0.01f);
+
+	WavetableOscillator oscillator1, oscillator2;
+	oscillator1.setFrequency(110.0f, sampleRate);
+	oscillator2.setFrequency(330.0f, sampleRate);
+	const int tableIndex1 = WavetableSet::getTableIndex(110.0f);
+	const int tableIndex2 = WavetableSet::getTableIndex(330.0f);
+
+	std::vector<float> output1((size_t) blockSize), output2((size_t) blockSize);
+	volatile float sink = 0.0f;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int block = 0; block < numBlocks; ++block)
+	{
+		bank.render(output1.data(), output2.data(), blockSize);
+		sink = sink + output1[0] + output2[0];
+	}
+	printTiming("Additive bank", secondsSince(start));
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int block = 0; block < numBlocks; ++block)
+	{
+		oscillator1.render(tables->getTable(0, tableIndex1), output1.data(), blockSize);
+		oscillator2.render(tables->getTable(1, tableIndex2), output2.data(), blockSize);
+		sink = sink + output1[0] + output2[0];
+	}
+	printTiming("Wavetables", secondsSince(start));
+
+	return worstErrorDb < -20.0;
+}
+
+
+bool benchParallelVoices()
+{
+	//Render 32 held notes with 0 (serial) to N workers.
+	//The output must be identical to the serial rendering whatever the number of workers.
+
+	std::cout << "Test 4: voice-parallel rendering, 32 voices" << std::endl;
+
+	const int numVoices = 32;
+	const int numRenderBlocks = numBlocks / 4;
+
+	const SynthParameterSnapshot snapshot = createSnapshot();
+
+	auto render = [&](int numWorkers, std::vector<float>& output)
+	{
+		ParallelSynthesiser synth;
+		prepareSynth(synth, snapshot, numVoices);
+		synth.setNumWorkers(numWorkers);
+		synth.setParallelThreshold(2);
+		synth.setCpuBudget(0.7f); //the plugin's default: a late worker delays the block, it never drops a voice
+
+		for (int i = 0; i < numVoices; ++i)
+			synth.noteOn(1, 36 + i * 2, 0.8f);
+
+		juce::AudioBuffer<float> buffer(2, blockSize);
+		juce::MidiBuffer midi;
+		output.clear();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int block = 0; block < numRenderBlocks; ++block)
+		{
+			buffer.clear();
+			synth.renderNextBlock(buffer, midi, 0, blockSize);
+			output.insert(output.end(), buffer.getReadPointer(0), buffer.getReadPointer(0) + blockSize);
+		}
+		return secondsSince(start);
+	};
+
+	std::vector<float> serialOutput, output;
+	const double serialSeconds = render(0, serialOutput);
+	std::cout << "Serial: " << serialSeconds * 1.0e3 / numRenderBlocks << " ms/block" << std::endl;
+
+	bool identical = true;
+	const int maxWorkers = juce::jmax(1, juce::SystemStats::getNumCpus() - 1);
+
+	for (int numWorkers = 1; numWorkers <= maxWorkers; ++numWorkers)
+	{
+		const double seconds = render(numWorkers, output);
+		identical &= output == serialOutput;
+
+		std::cout << numWorkers + 1 << " cores: " << seconds * 1.0e3 / numRenderBlocks << " ms/block, speedup "
+			<< serialSeconds / seconds << "x" << (output == serialOutput ? "" : " (output differs!)") << std::endl;
+	}
+
+	//Notes starting and ending inside the blocks: juce::Synthesiser splits the blocks at the events,
+	//and the voices must read the ramps at their position in the block, as with a plain juce::Synthesiser
+	SynthParameterSnapshot ramps = createSnapshot();
+	ramps.oscMix1 = { 0.1f, 0.6f };
+	ramps.cutFloor = { 200.0f, 800.0f };
+	ramps.cutPeak = { 3000.0f, 8000.0f };
+
+	auto renderEvents = [&](juce::Synthesiser& synth, std::vector<float>& events)
+	{
+		juce::AudioBuffer<float> buffer(2, blockSize);
+		std::vector<int> held;
+		int numNotes = 0;
+		events.clear();
+
+		for (int block = 0; block < numRenderBlocks / 4; ++block)
+		{
+			//A note every 128 samples, the last 4 held
+			juce::MidiBuffer midi;
+			for (int position = 37; position < blockSize; position += 128)
+			{
+				held.push_back(40 + numNotes++ % 40);
+				midi.addEvent(juce::MidiMessage::noteOn(1, held.back(), 0.8f), position);
+
+				if (held.size() > 4)
+				{
+					midi.addEvent(juce::MidiMessage::noteOff(1, held.front()), position);
+					held.erase(held.begin());
+				}
+			}
+
+			buffer.clear();
+			synth.renderNextBlock(buffer, midi, 0, blockSize);
+			events.insert(events.end(), buffer.getReadPointer(0), buffer.getReadPointer(0) + blockSize);
+		}
+	};
+
+	std::vector<float> plainEvents, parallelEvents;
+	{
+		juce::Synthesiser plain;
+		addVoices(plain, ramps, 32, 0.01f); //enough voices for the released notes: none is stolen
+		renderEvents(plain, plainEvents);
+	}
+	{
+		ParallelSynthesiser synth;
+		prepareSynth(synth, ramps, 32, 0.01f);
+		synth.setNumWorkers(maxWorkers);
+		synth.setParallelThreshold(2);
+		synth.setCpuBudget(1.0e6f); //juce::Synthesiser does not steal voices for the CPU budget
+		renderEvents(synth, parallelEvents);
+	}
+
+	const bool sameEvents = plainEvents == parallelEvents;
+	std::cout << "Notes inside the blocks, " << maxWorkers + 1 << " cores: "
+		<< (sameEvents ? "same output as juce::Synthesiser" : "output differs from juce::Synthesiser!") << std::endl;
+
+	return identical && sameEvents;
+}
+
+
+bool testLevelOfDetail()
+{
+	//Same notes rendered with and without the level of detail (-100 dB):
+	//a high note through a low cutoff, and a long release tail of a chord.
+	//The difference must stay below the threshold for every culled partial
+	//(plus the rounding of the resynced phases).
+
+	std::cout << "Test 5: level of detail (partial culling, early end of the voices) at -100 dB" << std::endl;
+
+	const float threshold = juce::Decibels::decibelsToGain(-100.0f);
+	const int numRenderBlocks = numBlocks / 4;
+
+	struct Scenario
+	{
+		const char* name;
+		std::vector<int> notes;
+		float cutoff;
+		int noteOffBlock;
+	};
+
+	const Scenario scenarios[] = {
+		{ "High note, cutoff 300 Hz", { 96 }, 300.0f, numRenderBlocks },
+		{ "Chord, 4 s release", { 48, 52, 55, 60 }, 2000.0f, 10 }
+	};
+
+	bool accurate = true;
+
+	for (const auto& scenario : scenarios)
+	{
+		SynthParameterSnapshot snapshot = createSnapshot();
+		snapshot.cutFloor = { scenario.cutoff, scenario.cutoff };
+		snapshot.cutPeak = { scenario.cutoff, scenario.cutoff };
+
+		auto render = [&](float cullingThreshold, std::vector<float>& output)
+		{
+			snapshot.cullingThreshold = cullingThreshold;
+
+			ParallelSynthesiser synth;
+			prepareSynth(synth, snapshot, (int) scenario.notes.size(), 1.0f);
+
+			for (int note : scenario.notes)
+				synth.noteOn(1, note, 0.8f);
+
+			juce::AudioBuffer<float> buffer(2, blockSize);
+			juce::MidiBuffer midi;
+			output.clear();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int block = 0; block < numRenderBlocks; ++block)
+			{
+				if (block == scenario.noteOffBlock)
+					synth.allNotesOff(1, true);
+
+				buffer.clear();
+				synth.renderNextBlock(buffer, midi, 0, blockSize);
+				output.insert(output.end(), buffer.getReadPointer(0), buffer.getReadPointer(0) + blockSize);
+			}
+			return secondsSince(start);
+		};
+
+		std::vector<float> fullOutput, lodOutput;
+		const double fullSeconds = render(0.0f, fullOutput);
+		const double lodSeconds = render(threshold, lodOutput);
+
+		double maxError = 0.0;
+		for (size_t i = 0; i < fullOutput.size(); ++i)
+			maxError = std::max(maxError, (double) std::abs(fullOutput[i] - lodOutput[i]));
+
+		const double maxAllowed = scenario.notes.size() * OscillatorBank::numPartials * threshold + 1.0e-4;
+		accurate &= maxError < maxAllowed;
+
+		std::cout << scenario.name << ": " << fullSeconds * 1.0e3 / numRenderBlocks << " ms/block without, "
+			<< lodSeconds * 1.0e3 / numRenderBlocks << " ms/block with level of detail, max difference "
+			<< juce::Decibels::gainToDecibels(maxError, -200.0) << " dB" << std::endl;
+	}
+
+	return accurate;
+}
+
+
+bool benchReverb()
+{
+	//The reverb used to be a juce::dsp::Convolution in every voice (8 of them), it is now one
+	//partitioned convolution on the bus. Check it against a direct convolution (delayed by one partition),
+	//and compare the cost of the two on a stereo bus.
+
+	std::cout << "Test 6: bus reverb (partitioned convolution) vs one convolution per voice" << std::endl;
+
+	const int irLength = 400;
+	const int partitionSize = 128;
+	const int numVoices = 8;
+	const int numRenderBlocks = numBlocks / 4;
+
+	juce::Random random(1);
+	std::vector<float> impulseResponse((size_t) irLength);
+	for (int i = 0; i < irLength; ++i)
+		impulseResponse[(size_t) i] = std::exp(-0.01f * (float) i) * (random.nextFloat() * 2.0f - 1.0f);
+
+	std::vector<float> input((size_t) blockSize * numRenderBlocks);
+	for (auto& sample : input)
+		sample = random.nextFloat() * 2.0f - 1.0f;
+
+	PartitionedImpulseResponse partitioned;
+	partitioned.build(impulseResponse.data(), irLength, partitionSize);
+
+	PartitionedConvolver convolver;
+	convolver.prepare(2, partitionSize, partitioned.numPartitions);
+	convolver.setImpulseResponse(&partitioned, 0);
+
+	juce::AudioBuffer<float> buffer(2, blockSize);
+	std::vector<float> output;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int block = 0; block < numRenderBlocks; ++block)
+	{
+		for (int channel = 0; channel < 2; ++channel)
+		{
+			buffer.copyFrom(channel, 0, input.data() + block * blockSize, blockSize);
+			convolver.processAdding(channel, buffer.getWritePointer(channel), blockSize);
+		}
+		output.insert(output.end(), buffer.getReadPointer(0), buffer.getReadPointer(0) + blockSize);
+	}
+	const double busSeconds = secondsSince(start);
+
+	double maxError = 0.0;
+	for (size_t i = 0; i < output.size(); ++i)
+	{
+		double expected = input[i];
+		for (int tap = 0; tap < irLength && tap + partitionSize <= (int) i; ++tap)
+			expected += impulseResponse[(size_t) tap] * input[i - (size_t) partitionSize - (size_t) tap];
+
+		maxError = std::max(maxError, std::abs(expected - (double) output[i]));
+	}
+
+	//The previous implementation: a convolution per voice, each on its own voice buffer
+	juce::dsp::ProcessSpec spec{ sampleRate, (juce::uint32) blockSize, 2 };
+	std::vector<std::unique_ptr<juce::dsp::Convolution>> voiceConvolutions;
+	for (int i = 0; i < numVoices; ++i)
+	{
+		auto convolution = std::make_unique<juce::dsp::Convolution>();
+		juce::AudioBuffer<float> response(1, irLength);
+		response.copyFrom(0, 0, impulseResponse.data(), irLength);
+		convolution->loadImpulseResponse(std::move(response), sampleRate, juce::dsp::Convolution::Stereo::no,
+			juce::dsp::Convolution::Trim::no, juce::dsp::Convolution::Normalise::no);
+		convolution->prepare(spec);
+		voiceConvolutions.push_back(std::move(convolution));
+	}
+
+	//The responses are loaded in the background, and picked up while processing
+	for (int block = 0; block < 20; ++block)
+	{
+		for (auto& convolution : voiceConvolutions)
+		{
+			juce::dsp::AudioBlock<float> audioBlock(buffer);
+			convolution->process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int block = 0; block < numRenderBlocks; ++block)
+	{
+		for (auto& convolution : voiceConvolutions)
+		{
+			for (int channel = 0; channel < 2; ++channel)
+				buffer.copyFrom(channel, 0, input.data() + block * blockSize, blockSize);
+
+			juce::dsp::AudioBlock<float> audioBlock(buffer);
+			convolution->process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+		}
+	}
+	const double voiceSeconds = secondsSince(start);
+
+	std::cout << "Bus reverb: " << busSeconds * 1.0e3 / numRenderBlocks << " ms/block, " << numVoices << " voice reverbs: "
+		<< voiceSeconds * 1.0e3 / numRenderBlocks << " ms/block, max error " << juce::Decibels::gainToDecibels(maxError, -200.0) << " dB" << std::endl;
+
+	return maxError < 1.0e-4;
+}
+
+
+bool benchChorus()
+{
+	//The chorus runs once on the stereo bus, whatever the number of voices.
+	//With no modulation, the delayed signal must be the input shifted by the delay (fractional here,
+	//through the interpolation), then time the modulated chorus.
+
+	std::cout << "Test 7: bus chorus (modulated delay)" << std::endl;
+
+	const int numRenderBlocks = numBlocks / 4;
+	const float mix = 0.5f;
+
+	//MD_DELAY for a delay of 187.2 samples, no depth
+	const float delay = 0.1f;
+	const double delaySamples = (BusChorus::minDelayMs + delay * (BusChorus::maxDelayMs - BusChorus::minDelayMs)) * 0.001 * sampleRate;
+
+	auto input = [](int i) { return (float) std::sin(0.02 * i); };
+
+	BusChorus chorus;
+	chorus.prepare(sampleRate, 2);
+
+	juce::AudioBuffer<float> buffer(2, blockSize);
+	double maxError = 0.0;
+
+	for (int block = 0; block < numRenderBlocks; ++block)
+	{
+		for (int channel = 0; channel < 2; ++channel)
+			for (int i = 0; i < blockSize; ++i)
+				buffer.setSample(channel, i, input(block * blockSize + i));
+
+		chorus.process(buffer, blockSize, delay, 0.0f, mix);
+
+		for (int i = 0; i < blockSize; ++i)
+		{
+			const int n = block * blockSize + i;
+			if (n < delaySamples + 4)
+				continue;
+
+			const double expected = input(n) + mix * std::sin(0.02 * (n - delaySamples));
+			maxError = std::max(maxError, std::abs(expected - (double) buffer.getSample(0, i)));
+		}
+	}
+
+	//Modulated, on noise
+	juce::Random random(1);
+	for (int channel = 0; channel < 2; ++channel)
+		for (int i = 0; i < blockSize; ++i)
+			buffer.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+
+	juce::AudioBuffer<float> block(2, blockSize);
+	chorus.reset();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < numRenderBlocks; ++i)
+	{
+		block.makeCopyOf(buffer, true);
+		chorus.process(block, blockSize, 0.5f, 1.0f, mix);
+	}
+	const double seconds = secondsSince(start);
+
+	std::cout << "Chorus: " << seconds * 1.0e9 / ((double) blockSize * numRenderBlocks) << " ns/sample (stereo), "
+		<< seconds * 1.0e3 / numRenderBlocks << " ms/block, max error " << juce::Decibels::gainToDecibels(maxError, -200.0) << " dB" << std::endl;
+
+	return maxError < 1.0e-4;
+}
+
+
+bool benchFreeze()
+{
+	//Frozen notes are rendered by the voice itself: played back at their root pitch, they must give
+	//the samples of the live voices until the loop starts. Then the two are timed with the same chord.
+
+	std::cout << "Test 8: freeze mode (sampler playback) vs additive voices" << std::endl;
+
+	const int numVoices = 24;
+	const int noteStep = 3;
+	const int numRenderBlocks = numBlocks / 4;
+
+	//The envelopes of prepareSynth()
+	SynthParameterSnapshot snapshot = createSnapshot();
+	snapshot.adsr1 = { 0.01f, 0.1f, 0.8f, 0.1f };
+	snapshot.adsr2 = { 0.02f, 0.1f, 0.5f, 0.1f };
+	snapshot.adsrC = { 0.05f, 0.2f, 0.3f, 0.1f };
+	snapshot.cullingThreshold = juce::Decibels::decibelsToGain(-100.0f);
+
+	const FreezeSettings settings = FreezeSettings::fromSnapshot(snapshot);
+
+	FrozenNoteSet set;
+	set.prepare(settings, sampleRate, noteStep);
+
+	const std::atomic<bool> abandon{ false };
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < set.notes.size(); ++i)
+		set.notes[i].render(FrozenNoteSet::lowestNote + (int) i * noteStep, settings, sampleRate, abandon);
+	const double freezeSeconds = secondsSince(start);
+
+	auto render = [&](bool freeze, std::vector<float>& output)
+	{
+		snapshot.frozen = freeze ? &set : nullptr;
+		snapshot.freezeNewNotes = freeze;
+
+		ParallelSynthesiser synth;
+		prepareSynth(synth, snapshot, numVoices);
+
+		//Root notes only: no pitch shift
+		for (int i = 0; i < numVoices; ++i)
+			synth.noteOn(1, FrozenNoteSet::lowestNote + (i + 2) * noteStep, 0.8f);
+
+		juce::AudioBuffer<float> buffer(2, blockSize);
+		juce::MidiBuffer midi;
+		output.clear();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int block = 0; block < numRenderBlocks; ++block)
+		{
+			buffer.clear();
+			synth.renderNextBlock(buffer, midi, 0, blockSize);
+			output.insert(output.end(), buffer.getReadPointer(0), buffer.getReadPointer(0) + blockSize);
+		}
+		return secondsSince(start);
+	};
+
+	std::vector<float> liveOutput, frozenOutput;
+	const double liveSeconds = render(false, liveOutput);
+	const double frozenSeconds = render(true, frozenOutput);
+
+	double maxError = 0.0;
+	const size_t compared = std::min((size_t) set.notes.front().loopStart, liveOutput.size());
+	for (size_t i = 0; i < compared; ++i)
+		maxError = std::max(maxError, (double) std::abs(liveOutput[i] - frozenOutput[i]));
+
+	std::cout << "Rendering " << set.notes.size() << " notes: " << freezeSeconds << " s. " << numVoices << " voices, additive: "
+		<< liveSeconds * 1.0e3 / numRenderBlocks << " ms/block, frozen: " << frozenSeconds * 1.0e3 / numRenderBlocks
+		<< " ms/block, max error " << juce::Decibels::gainToDecibels(maxError, -200.0) << " dB" << std::endl;
+
+	return maxError < 1.0e-4;
+}
+
+
+int main()
+{
+	bool passed = true;
+
+	passed &= benchOscillatorBank();
+	passed &= testHarmonicFilter();
+	passed &= testWavetables();
+	passed &= benchParallelVoices();
+	passed &= testLevelOfDetail();
+	passed &= benchReverb();
+	passed &= benchChorus();
+	passed &= benchFreeze();
+
+	std::cout << (passed ? "All accuracy checks passed" : "Some accuracy checks FAILED") << std::endl;
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+#include "NeuralNetwork.h"
+#include <torch/torch.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+ #include <pthread.h>
+ #include <sched.h>
+#endif
+
+
+//Benchmark: deadline misses of simulated audio threads while the network runs in the background.
+//Every audio thread renders 512-sample blocks at 48 kHz (10.7 ms each) with a fixed amount of work,
+//taking about half of the period on an idle core. A block finishing after its deadline is an xrun in a host.
+//
+//Usage: bench_inference [model.pt] [default|governed|background]
+//The model is the first argument or NEURAL_SYNTH_MODEL. The pool threads libtorch starts keep
+//the priority of the thread that started them: run one scenario per process for exact numbers.
+
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr double sampleRate = 48000.0;
+	constexpr int blockSize = 512;
+	constexpr double dspLoad = 0.5; //fraction of the block period
+	constexpr int numPasses = 5; //forward passes per scenario
+
+	const std::chrono::duration<double> blockPeriod(blockSize / sampleRate);
+
+	double secondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	//Stand-in for the synth: a fixed number of sine evaluations per block
+	float renderWork(long numIterations)
+	{
+		float sum = 0.0f;
+		for (long i = 0; i < numIterations; ++i)
+			sum += std::sin(0.001f * (float) i);
+		return sum;
+	}
+
+	//Iterations of renderWork filling dspLoad of a block period on this machine
+	long calibrateWork()
+	{
+		const long probeIterations = 1000000;
+		const auto start = Clock::now();
+		volatile float sink = renderWork(probeIterations);
+		(void) sink;
+		return (long) (probeIterations * dspLoad * blockPeriod.count() / secondsSince(start));
+	}
+
+	struct AudioStats
+	{
+		std::atomic<int> numBlocks{ 0 };
+		std::atomic<int> numMisses{ 0 };
+		std::atomic<double> worstLateness{ 0.0 }; //seconds
+	};
+
+	void runAudioThread(long workPerBlock, const std::atomic<bool>& running, AudioStats& stats)
+	{
+#if defined(__linux__)
+		//Hosts run their audio threads with a real-time priority, when they are allowed to
+		sched_param parameters{};
+		parameters.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+		pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+#endif
+
+		const auto start = Clock::now();
+		volatile float sink = 0.0f;
+
+		for (long block = 0; running.load(); ++block)
+		{
+			const auto blockStart = start + std::chrono::duration_cast<Clock::duration>(blockPeriod * block);
+			const auto deadline = start + std::chrono::duration_cast<Clock::duration>(blockPeriod * (block + 1));
+
+			std::this_thread::sleep_until(blockStart);
+
+			sink = sink + renderWork(workPerBlock);
+
+			const double lateness = std::chrono::duration<double>(Clock::now() - deadline).count();
+
+			stats.numBlocks++;
+			if (lateness > 0.0)
+			{
+				stats.numMisses++;
+				if (lateness > stats.worstLateness.load())
+					stats.worstLateness.store(lateness);
+			}
+		}
+	}
+
+	void runScenario(const std::string& name, NeuralNetwork& nn, const NeuralNetwork::SchedulingPolicy& policy,
+		torch::jit::IValue& input, long workPerBlock, int numAudioThreads)
+	{
+		AudioStats stats;
+		std::atomic<bool> running{ true };
+
+		std::vector<std::thread> audioThreads;
+		for (int i = 0; i < numAudioThreads; ++i)
+			audioThreads.emplace_back(runAudioThread, workPerBlock, std::cref(running), std::ref(stats));
+
+		//The inference runs on its own thread, as in the plugin
+		double secondsPerPass = 0.0;
+		std::thread inferenceThread([&] {
+			NeuralNetwork::applySchedulingPolicy(policy);
+			NeuralNetwork::BackgroundScope backgroundScope(policy);
+
+			const auto start = Clock::now();
+			for (int i = 0; i < numPasses; ++i)
+				nn.forward(input);
+
+			secondsPerPass = secondsSince(start) / numPasses;
+		});
+
+		inferenceThread.join();
+		running.store(false);
+
+		for (auto& thread : audioThreads)
+			thread.join();
+
+		std::cout << std::left << std::setw(30) << name
+			<< std::right << std::setw(12) << std::fixed << std::setprecision(1) << secondsPerPass * 1000.0
+			<< std::setw(10) << stats.numBlocks.load()
+			<< std::setw(10) << stats.numMisses.load()
+			<< std::setw(14) << std::setprecision(2) << stats.worstLateness.load() * 1000.0 << std::endl;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	std::string modelPath;
+	if (argc > 1)
+		modelPath = argv[1];
+	else if (const char* environmentPath = std::getenv("NEURAL_SYNTH_MODEL"))
+		modelPath = environmentPath;
+
+	if (modelPath.empty())
+	{
+		std::cout << "Usage: bench_inference <traced_model.pt> [scenario]" << std::endl;
+		return 1;
+	}
+
+	const std::string onlyScenario = argc > 2 ? argv[2] : "";
+
+	NeuralNetwork nn;
+
+	try {
+		nn.load(modelPath);
+	}
+	catch (const c10::Error& e) {
+		std::cerr << "error loading the model\n" << e.what_without_backtrace() << std::endl;
+		return 1;
+	}
+
+	std::cerr << nn.getLoadWarnings();
+	std::cout << "Loaded model " << modelPath << std::endl;
+
+	auto x = torch::Dict<std::string, torch::Tensor>();
+	x.insert("audio", torch::randn({ 1, 4 * (int) NeuralNetwork::sampleRate }) * 0.1);
+	torch::jit::IValue input = torch::ivalue::from(x);
+
+	const int numCores = (int) std::max(2u, std::thread::hardware_concurrency());
+	const int numAudioThreads = numCores / 2;
+	const long workPerBlock = calibrateWork();
+
+	std::cout << numAudioThreads << " audio threads, " << blockSize << " samples at " << sampleRate << " Hz, "
+		<< dspLoad * 100.0 << "% load each" << std::endl << std::endl;
+	std::cout << std::left << std::setw(30) << "Scenario" << std::right << std::setw(12) << "ms/pass"
+		<< std::setw(10) << "blocks" << std::setw(10) << "misses" << std::setw(14) << "worst (ms)" << std::endl;
+
+	//libtorch as configured out of the box: every core, normal priority
+	NeuralNetwork::SchedulingPolicy defaultPolicy;
+	defaultPolicy.intraOpThreads = numCores;
+	defaultPolicy.interOpThreads = 0;
+	defaultPolicy.lowPriority = false;
+
+	NeuralNetwork::SchedulingPolicy governedPolicy;
+
+	NeuralNetwork::SchedulingPolicy backgroundPolicy;
+	backgroundPolicy.backgroundFriendly = true;
+
+	if (onlyScenario.empty() || onlyScenario == "default")
+		runScenario("libtorch default", nn, defaultPolicy, input, workPerBlock, numAudioThreads);
+
+	if (onlyScenario.empty() || onlyScenario == "governed")
+		runScenario("governed (2 threads, idle)", nn, governedPolicy, input, workPerBlock, numAudioThreads);
+
+	if (onlyScenario.empty() || onlyScenario == "background")
+		runScenario("governed, background-friendly", nn, backgroundPolicy, input, workPerBlock, numAudioThreads);
+
+	return 0;
+}
@@ -0,0 +1,295 @@
+#include "InferenceBackend.h"
+#include "AudioFileLoader.h"
+#include "EstimationCache.h"
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_cryptography/juce_cryptography.h>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+
+//Headless parameter estimation for a directory of audio clips (e.g. audio_examples/ood), to build preset libraries.
+//Writes <clip>.json next to each clip (or in the output directory) with the normalised network outputs.
+//
+//Usage: estimate_params <input directory> [output directory] [--model path] [--batch N] [--recursive] [--no-cache] [--int8]
+//The model is --model or NEURAL_SYNTH_MODEL.
+//
+//The clips are decoded on a separate thread while the previous batch runs through the network,
+//then each batch is a single forward pass (clips padded or cropped to the length the network was trained on, 4 s).
+//The clips found in the EstimationCache of the plugin (same audio, same model) skip the network,
+//and the new results are added to it.
+
+
+namespace
+{
+	struct Batch
+	{
+		std::vector<juce::File> files;
+		std::vector<float> audio; //the clips one after the other, clipSamples each
+	};
+
+	//Batches decoded ahead of the inference: the decoder waits when maxQueued are ready
+	class BatchQueue
+	{
+	public:
+
+		void push(Batch&& batch)
+		{
+			std::unique_lock<std::mutex> scopedLock(lock);
+			changed.wait(scopedLock, [&] { return batches.size() < maxQueued; });
+			batches.push_back(std::move(batch));
+			changed.notify_all();
+		}
+
+		void finish()
+		{
+			std::lock_guard<std::mutex> scopedLock(lock);
+			finished = true;
+			changed.notify_all();
+		}
+
+		//False when all the batches were taken
+		bool pop(Batch& batch)
+		{
+			std::unique_lock<std::mutex> scopedLock(lock);
+			changed.wait(scopedLock, [&] { return !batches.empty() || finished; });
+
+			if (batches.empty())
+				return false;
+
+			batch = std::move(batches.front());
+			batches.pop_front();
+			changed.notify_all();
+			return true;
+		}
+
+	private:
+
+		static constexpr size_t maxQueued = 2;
+
+		std::mutex lock;
+		std::condition_variable changed;
+		std::deque<Batch> batches;
+		bool finished = false;
+	};
+
+	//Decode a clip at the rate of the network at the end of audio, padded with zeros or cropped to clipSamples.
+	//False if the file cannot be read
+	bool decode(const juce::File& file, juce::AudioFormatManager& formatManager, double sampleRate, int clipSamples,
+		std::vector<float>& audio)
+	{
+		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+		if (reader == nullptr || reader->lengthInSamples == 0)
+			return false;
+
+		AudioFileLoader loader(*reader, sampleRate);
+		std::vector<float> decoded((size_t) loader.getNumOutputSamples());
+		loader.read(decoded.data(), [](float) { return true; });
+
+		EstimationCache::fitToClip(decoded, clipSamples);
+		audio.insert(audio.end(), decoded.begin(), decoded.end());
+
+		return true;
+	}
+
+	//Key -> list of the normalised values
+	juce::var toJson(const InferenceBackend::OutputLayout& layout, const float* values)
+	{
+		auto* object = new juce::DynamicObject();
+
+		for (const auto& entry : layout.entries)
+		{
+			juce::Array<juce::var> list;
+			for (int i = 0; i < entry.size; ++i)
+				list.add(values[entry.offset + i]);
+
+			object->setProperty(juce::Identifier(entry.name), list);
+		}
+
+		return juce::var(object);
+	}
+
+	void printUsage()
+	{
+		std::cout << "Usage: estimate_params <input directory> [output directory] [--model path] [--batch N] [--recursive] [--no-cache] [--int8]" << std::endl;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	juce::File inputDirectory, outputDirectory;
+	juce::String modelPath = juce::SystemStats::getEnvironmentVariable("NEURAL_SYNTH_MODEL", {});
+	int batchSize = 16;
+	bool recursive = false;
+	bool useCache = true;
+	InferenceBackend::Precision precision = InferenceBackend::Precision::float32;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const juce::String argument(argv[i]);
+
+		if (argument == "--model" && i + 1 < argc)
+			modelPath = argv[++i];
+		else if (argument == "--batch" && i + 1 < argc)
+			batchSize = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+		else if (argument == "--recursive")
+			recursive = true;
+		else if (argument == "--no-cache")
+			useCache = false;
+		else if (argument == "--int8")
+			precision = InferenceBackend::Precision::int8;
+		else if (inputDirectory == juce::File())
+			inputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile(argument);
+		else
+			outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile(argument);
+	}
+
+	if (!inputDirectory.isDirectory() || modelPath.isEmpty())
+	{
+		printUsage();
+		return 1;
+	}
+
+	if (outputDirectory != juce::File() && !outputDirectory.createDirectory())
+	{
+		std::cerr << "cannot create " << outputDirectory.getFullPathName() << std::endl;
+		return 1;
+	}
+
+	const juce::String modelChecksum = juce::SHA256(juce::File(modelPath)).toHexString();
+	std::unique_ptr<InferenceBackend> backend = InferenceBackend::createForModel(modelPath.toStdString());
+
+	try {
+		backend->load(modelPath.toStdString(), precision);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "error loading the model\n" << e.what() << std::endl;
+		return 1;
+	}
+
+	std::cerr << backend->getLoadWarnings();
+	std::cout << "Loaded " << backend->getName() << " model " << modelPath << std::endl;
+
+	const InferenceBackend::OutputLayout& layout = backend->getOutputLayout();
+	const int clipSamples = backend->getClipSamples();
+
+	//Nothing else to share the machine with: every core, normal priority
+	InferenceBackend::SchedulingPolicy policy;
+	policy.intraOpThreads = (int) juce::jmax(1u, std::thread::hardware_concurrency());
+	policy.lowPriority = false;
+
+	juce::AudioFormatManager formatManager;
+	formatManager.registerBasicFormats();
+
+	const juce::Array<juce::File> files = inputDirectory.findChildFiles(juce::File::findFiles, recursive,
+		formatManager.getWildcardForAllFormats());
+
+	std::cout << files.size() << " files, batches of " << batchSize << std::endl;
+
+	BatchQueue queue;
+
+	std::thread decoder([&] {
+		Batch batch;
+
+		for (const auto& file : files)
+		{
+			if (!decode(file, formatManager, backend->getSampleRate(), clipSamples, batch.audio))
+			{
+				std::cerr << "cannot read " << file.getFullPathName() << std::endl;
+				continue;
+			}
+
+			batch.files.push_back(file);
+
+			if ((int) batch.files.size() == batchSize)
+				queue.push(std::exchange(batch, Batch()));
+		}
+
+		if (!batch.files.empty())
+			queue.push(std::move(batch));
+
+		queue.finish();
+	});
+
+	const auto start = juce::Time::getMillisecondCounterHiRes();
+	int numEstimated = 0;
+	int numFailed = 0;
+	int numCached = 0;
+
+	auto& cache = EstimationCache::getInstance();
+	const juce::String modelVariant = EstimationCache::getModelVariant(precision);
+
+	auto writeParameters = [&](const juce::File& file, const float* values) {
+		const juce::File directory = outputDirectory == juce::File() ? file.getParentDirectory() : outputDirectory;
+		const juce::File parameterFile = directory.getChildFile(file.getFileNameWithoutExtension() + ".json");
+
+		if (parameterFile.replaceWithText(juce::JSON::toString(toJson(layout, values))))
+			++numEstimated;
+		else
+			++numFailed;
+	};
+
+	std::vector<float> values((size_t) layout.numValues);
+
+	Batch batch;
+	while (queue.pop(batch))
+	{
+		//The clips estimated before are written straight away, the others go through the network together.
+		//The key is the clip as the network sees it (EstimationCache::fitToClip), as in the plugin
+		std::vector<juce::File> newFiles;
+		std::vector<float> newAudio;
+		std::vector<juce::String> newKeys;
+
+		for (size_t i = 0; i < batch.files.size(); ++i)
+		{
+			const float* clip = batch.audio.data() + i * (size_t) clipSamples;
+			const juce::String key = EstimationCache::makeKey(clip, (size_t) clipSamples, modelChecksum, modelVariant);
+
+			EstimationCache::Record record;
+			if (useCache && cache.load(key, record) && EstimationCache::readRecord(record, layout, values.data()))
+			{
+				writeParameters(batch.files[i], values.data());
+				++numCached;
+				continue;
+			}
+
+			newFiles.push_back(batch.files[i]);
+			newAudio.insert(newAudio.end(), clip, clip + clipSamples);
+			newKeys.push_back(key);
+		}
+
+		if (newFiles.empty())
+			continue;
+
+		try {
+			std::vector<float> outputs(newFiles.size() * (size_t) layout.numValues);
+			backend->estimate(newAudio.data(), (int) newFiles.size(), clipSamples, outputs.data(), policy);
+
+			for (size_t i = 0; i < newFiles.size(); ++i)
+			{
+				const float* clipOutputs = outputs.data() + i * (size_t) layout.numValues;
+
+				if (useCache)
+					cache.store(newKeys[i], EstimationCache::makeRecord(layout, clipOutputs));
+
+				writeParameters(newFiles[i], clipOutputs);
+			}
+		}
+		catch (const std::exception& e) {
+			std::cerr << "estimation failed: " << e.what() << std::endl;
+			numFailed += (int) newFiles.size();
+		}
+	}
+
+	decoder.join();
+
+	const double seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+	std::cout << numEstimated << " estimated (" << numCached << " from the cache), " << numFailed << " failed in " << seconds << " s ("
+		<< numEstimated / juce::jmax(seconds, 0.001) << " files/s)" << std::endl;
+
+	return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+#include "OfflineRenderer.h"
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//Headless resynthesis: renders MIDI files with the synth to WAV files, faster than real time, without a host.
+//
+//Usage: render_midi <MIDI file or directory> <parameters> [output directory] [--jobs N] [--rate 48000] [--voices 32] [--bits 24] [--recursive]
+//
+//The parameters are a JSON file for all the MIDI files, or a directory holding <MIDI file name>.json for each.
+//A JSON file is either parameter ID -> value, or the output of estimate_params (see OfflineRenderer::setParameters).
+//Writes <MIDI file name>.wav next to each MIDI file (or in the output directory).
+//--jobs renders that many files at the same time, one renderer per thread.
+
+
+namespace
+{
+	void printUsage()
+	{
+		std::cout << "Usage: render_midi <MIDI file or directory> <parameters .json or directory> [output directory] [--jobs N] [--rate 48000] [--voices 32] [--bits 24] [--recursive]" << std::endl;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	//The parameters are an AudioProcessorValueTreeState, which wants a message manager
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+	juce::File input, parameters, outputDirectory;
+	OfflineRenderer::Options options;
+	int numJobs = (int) juce::jmax(1u, std::thread::hardware_concurrency());
+	bool recursive = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const juce::String argument(argv[i]);
+
+		if (argument == "--jobs" && i + 1 < argc)
+			numJobs = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+		else if (argument == "--rate" && i + 1 < argc)
+			options.sampleRate = juce::jmax(8000.0, juce::String(argv[++i]).getDoubleValue());
+		else if (argument == "--voices" && i + 1 < argc)
+			options.numVoices = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+		else if (argument == "--bits" && i + 1 < argc)
+			options.bitsPerSample = juce::String(argv[++i]).getIntValue();
+		else if (argument == "--recursive")
+			recursive = true;
+		else if (input == juce::File())
+			input = juce::File::getCurrentWorkingDirectory().getChildFile(argument);
+		else if (parameters == juce::File())
+			parameters = juce::File::getCurrentWorkingDirectory().getChildFile(argument);
+		else
+			outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile(argument);
+	}
+
+	if (!input.exists() || !parameters.exists())
+	{
+		printUsage();
+		return 1;
+	}
+
+	if (outputDirectory != juce::File() && !outputDirectory.createDirectory())
+	{
+		std::cerr << "cannot create " << outputDirectory.getFullPathName() << std::endl;
+		return 1;
+	}
+
+	juce::Array<juce::File> files;
+	if (input.isDirectory())
+		files = input.findChildFiles(juce::File::findFiles, recursive, "*.mid;*.midi");
+	else
+		files.add(input);
+
+	//One parameter file for all the MIDI files is read once
+	juce::var sharedParameters;
+	if (!parameters.isDirectory())
+	{
+		sharedParameters = juce::JSON::parse(parameters);
+		if (sharedParameters.getDynamicObject() == nullptr)
+		{
+			std::cerr << "cannot read the parameters in " << parameters.getFullPathName() << std::endl;
+			return 1;
+		}
+	}
+
+	numJobs = juce::jmin(numJobs, files.size());
+	std::cout << files.size() << " files, " << numJobs << " jobs" << std::endl;
+
+	//Created here: the parameters must be created on the message thread
+	std::vector<std::unique_ptr<OfflineRenderer>> renderers;
+	for (int job = 0; job < numJobs; ++job)
+		renderers.push_back(std::make_unique<OfflineRenderer>(options));
+
+	std::atomic<int> nextFile{ 0 };
+	std::atomic<int> numRendered{ 0 };
+	std::atomic<int> numFailed{ 0 };
+	std::mutex printLock;
+
+	auto report = [&](const juce::String& message, bool failed) {
+		std::lock_guard<std::mutex> scopedLock(printLock);
+		(failed ? std::cerr : std::cout) << message << std::endl;
+		++(failed ? numFailed : numRendered);
+	};
+
+	const auto start = juce::Time::getMillisecondCounterHiRes();
+
+	std::vector<std::thread> threads;
+	for (int job = 0; job < numJobs; ++job)
+	{
+		threads.emplace_back([&, job] {
+			OfflineRenderer& renderer = *renderers[(size_t) job];
+
+			for (int index = nextFile++; index < files.size(); index = nextFile++)
+			{
+				const juce::File& file = files.getReference(index);
+
+				const juce::var fileParameters = parameters.isDirectory()
+					? juce::JSON::parse(parameters.getChildFile(file.getFileNameWithoutExtension() + ".json"))
+					: sharedParameters;
+
+				juce::Result result = renderer.setParameters(fileParameters);
+
+				const juce::File directory = outputDirectory == juce::File() ? file.getParentDirectory() : outputDirectory;
+				const juce::File wavFile = directory.getChildFile(file.getFileNameWithoutExtension() + ".wav");
+
+				if (result.wasOk())
+					result = renderer.render(file, wavFile);
+
+				if (result.wasOk())
+					report(wavFile.getFullPathName(), false);
+				else
+					report(file.getFileName() + ": " + result.getErrorMessage(), true);
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	const double seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+	std::cout << numRendered.load() << " rendered, " << numFailed.load() << " failed in " << seconds << " s" << std::endl;
+
+	return numFailed.load() == 0 ? 0 : 1;
+}
@@ -1,18 +1,76 @@
 #include "NeuralNetwork.h"
 #include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
 #include <torch/torch.h>
 #include <torch/script.h>
 
+#if defined(__linux__)
+ #include <unistd.h>
+#elif defined(__APPLE__)
+ #include <mach/mach.h>
+#elif defined(_WIN32)
+ #define NOMINMAX
+ #include <windows.h>
+ #include <psapi.h>
+#endif
+
 
 torch::jit::IValue loadTensor(std::string filename);
 std::vector<char> get_the_bytes(std::string filename);
 void printOutputTensorEntry(torch::IValue key, torch::Dict<torch::IValue, torch::IValue>& dict);
+size_t residentMemory();
+void compareWithReference(const std::string& name, NeuralNetwork& nn, size_t memory, torch::jit::IValue& input,
+	torch::Dict<torch::IValue, torch::IValue>& refOutputDict);
 
-int main()
+int main(int argc, char* argv[])
 {
 
 	//Test torchscript-imported SSSSM-DDSP neural network
+	//Model path: first argument, or the NEURAL_SYNTH_MODEL environment variable
+	std::string modelPath;
+	if (argc > 1)
+		modelPath = argv[1];
+	else if (const char* environmentPath = std::getenv("NEURAL_SYNTH_MODEL"))
+		modelPath = environmentPath;
+
+	if (modelPath.empty())
+	{
+		std::cout << "Usage: test_nn <traced_model.pt> [reference directory]" << std::endl;
+		return 1;
+	}
+
+	//Python input and output (in.pt, out.pt): second argument, the NEURAL_SYNTH_REFERENCE environment variable,
+	//or the directory of the model (traced_ssssm/ has all three)
+	std::string referenceDirectory;
+	if (argc > 2)
+		referenceDirectory = argv[2];
+	else if (const char* environmentDirectory = std::getenv("NEURAL_SYNTH_REFERENCE"))
+		referenceDirectory = environmentDirectory;
+	else
+	{
+		const size_t separator = modelPath.find_last_of("/\\");
+		referenceDirectory = separator == std::string::npos ? "." : modelPath.substr(0, separator);
+	}
+
 	NeuralNetwork nn;
+	const size_t memoryBeforeLoad = residentMemory();
+
+	try {
+		nn.load(modelPath);
+	}
+	catch (const c10::Error& e) {
+		std::cerr << "error loading the model\n" << e.what_without_backtrace() << std::endl;
+		return 1;
+	}
+
+	std::cerr << nn.getLoadWarnings();
+	std::cout << "Loaded model " << modelPath << std::endl;
+
+	const size_t float32Memory = std::max(residentMemory(), memoryBeforeLoad) - memoryBeforeLoad;
 
 	torch::jit::IValue example_input;
 	torch::jit::IValue example_output_concat;
@@ -26,11 +84,12 @@ int main()
 	try {
 		// Deserialize the ScriptModule from a file using torch::jit::load()
 
-		example_input_concat = loadTensor("C:/Users/Ricky/projects/music/fm_synth_libtorch/traced_ssssm/in.pt");
-		example_output_concat = loadTensor("C:/Users/Ricky/projects/music/fm_synth_libtorch/traced_ssssm/out.pt");
+		example_input_concat = loadTensor(referenceDirectory + "/in.pt");
+		example_output_concat = loadTensor(referenceDirectory + "/out.pt");
 	}
 	catch (const c10::Error& e) {
-		std::cerr << "error loading tensors\n";
+		std::cerr << "error loading tensors from " << referenceDirectory << "\n";
+		return 1;
 	}
 
 
@@ -61,6 +120,30 @@ int main()
 	}
 
 
+	//Test 2
+	//Dynamic int8 quantisation of the linear layers: deviation from the Python output,
+	//latency and memory, against the float32 model
+
+	NeuralNetwork quantisedNN;
+	const size_t memoryBeforeQuantisedLoad = residentMemory();
+
+	try {
+		quantisedNN.load(modelPath, NeuralNetwork::Precision::int8);
+	}
+	catch (const c10::Error& e) {
+		std::cerr << "error loading the quantised model\n" << e.what_without_backtrace() << std::endl;
+		return 1;
+	}
+
+	const size_t int8Memory = std::max(residentMemory(), memoryBeforeQuantisedLoad) - memoryBeforeQuantisedLoad;
+
+	std::cerr << quantisedNN.getLoadWarnings();
+	std::cout << std::endl << quantisedNN.getNumQuantisedLayers() << " linear layers quantised" << std::endl;
+
+	compareWithReference("float32", nn, float32Memory, input, refOutputDict);
+	compareWithReference("int8", quantisedNN, int8Memory, input, refOutputDict);
+
+
 
 
 	return 0;
@@ -102,6 +185,71 @@ void printOutputTensorEntry(torch::IValue key, torch::Dict<torch::IValue, torch:
 	}
 }
 
+//Deviation of every output from the reference (normalised parameters, so absolute differences),
+//then the average time of a forward pass and the memory taken by loading the model
+//(growth of the resident memory: approximate, the allocator keeps some of what it frees)
+void compareWithReference(const std::string& name, NeuralNetwork& nn, size_t memory, torch::jit::IValue& input,
+	torch::Dict<torch::IValue, torch::IValue>& refOutputDict)
+{
+	const int numRuns = 10;
+
+	torch::Dict<torch::IValue, torch::IValue> localOutputDict = nn.forward(input).toGenericDict();
+
+	std::cout << std::endl << name << std::endl;
+	std::cout << std::left << std::setw(16) << "Key" << std::right << std::setw(14) << "max dev" << std::setw(14) << "mean dev" << std::endl;
+
+	float maxDeviation = 0.0f;
+	double sumDeviation = 0.0;
+	int64_t numValues = 0;
+
+	for (auto it = refOutputDict.begin(); it != refOutputDict.end(); ++it) {
+		const std::string key = it->key().toStringRef();
+
+		torch::Tensor deviation = (localOutputDict.at(key).toTensor().to(torch::kFloat32) - it->value().toTensor().to(torch::kFloat32)).abs();
+
+		const float keyMax = deviation.max().item<float>();
+		const float keyMean = deviation.mean().item<float>();
+
+		std::cout << std::left << std::setw(16) << key << std::right << std::setw(14) << keyMax << std::setw(14) << keyMean << std::endl;
+
+		maxDeviation = std::max(maxDeviation, keyMax);
+		sumDeviation += deviation.sum().item<double>();
+		numValues += deviation.numel();
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < numRuns; ++i)
+		nn.forward(input);
+	const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / numRuns;
+
+	std::cout << "all parameters: max dev " << maxDeviation << ", mean dev " << sumDeviation / std::max<int64_t>(1, numValues) << std::endl;
+	std::cout << "latency " << milliseconds << " ms/pass, model memory " << memory / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+//Resident memory of the process in bytes (0 where it is not available)
+size_t residentMemory()
+{
+#if defined(__linux__)
+	std::ifstream statm("/proc/self/statm");
+	size_t totalPages = 0, residentPages = 0;
+	statm >> totalPages >> residentPages;
+	return residentPages * (size_t) sysconf(_SC_PAGESIZE);
+#elif defined(__APPLE__)
+	mach_task_basic_info info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) == KERN_SUCCESS)
+		return (size_t) info.resident_size;
+	return 0;
+#elif defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return (size_t) counters.WorkingSetSize;
+	return 0;
+#else
+	return 0;
+#endif
+}
+
 std::vector<char> get_the_bytes(std::string filename) {
 	std::ifstream input(filename, std::ios::binary);
 	std::vector<char> bytes(